@@ -45,15 +45,20 @@ SOFTWARE.
 
 #include "game/world.hh"
 
+#include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 
 #include <ctime>
+#include <cerrno>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 
 #include <random>
+#include <limits>
 #include <variant>
 #include <iostream>
 #include <algorithm>
@@ -71,13 +76,6 @@ std::ostream& operator<<(std::ostream& os, Style const& obj) {
 
 // Utils ----------------------------------------------------------------------------
 
-std::size_t random_range(std::size_t l, std::size_t u) {
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<std::size_t> distr(l, u);
-  return distr(gen);
-}
-
 std::string hex_encode(std::string_view const str) {
   char buf[3];
   std::string res;
@@ -93,6 +91,26 @@ std::string hex_encode(std::string_view const str) {
   return res;
 }
 
+// unsigned LEB128, seven bits per byte starting with the lowest
+static void varint_encode(std::string& buf, std::uint64_t val) {
+  while (val >= 0x80) {
+    buf += static_cast<char>((val & 0x7f) | 0x80);
+    val >>= 7;
+  }
+  buf += static_cast<char>(val);
+}
+
+// consumes the value from the front of buf, none when it runs out first
+static std::optional<std::uint64_t> varint_decode(std::string_view& buf) {
+  std::uint64_t res {0};
+  for (int shift = 0; shift < 64 && ! buf.empty(); shift += 7) {
+    auto const byte = static_cast<std::uint8_t>(buf.front());
+    buf.remove_prefix(1);
+    res |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if (! (byte & 0x80)) {return res;}
+  }
+  return {};
+}
 
 std::uint8_t hex_decode(std::string const& s) {
   unsigned int n;
@@ -104,6 +122,112 @@ Color hex_to_rgb(std::string const& str) {
   return Color(hex_decode(str.substr(0, 2)), hex_decode(str.substr(2, 2)), hex_decode(str.substr(4, 2)));
 }
 
+std::size_t text_cols(std::string_view const str) {
+  if (str.empty()) {return 0;}
+  if (str.size() == 1) {return 1;}
+  auto const width = u_getIntPropertyValue(Text::to_int32(str), UCHAR_EAST_ASIAN_WIDTH);
+  if (width == U_EA_FULLWIDTH || width == U_EA_WIDE) {return 2;}
+  return 1;
+}
+
+// style type for a colour depth in bits per pixel
+static std::optional<std::uint8_t> colour_depth(std::size_t const bits) {
+  switch (bits) {
+    case 24: return Style::Bit_24;
+    case 8: return Style::Bit_8;
+    case 4: return Style::Bit_4;
+    case 2: return Style::Bit_2;
+    default: return {};
+  }
+}
+
+static std::size_t colour_bits(std::uint8_t const type) {
+  std::array<std::size_t, 4> const bits {2, 4, 8, 24};
+  return bits.at(type);
+}
+
+bool operator==(Style const& lhs, Style const& rhs) {
+  return lhs.attr == rhs.attr && lhs.type == rhs.type &&
+    lhs.fg.r == rhs.fg.r && lhs.fg.g == rhs.fg.g && lhs.fg.b == rhs.fg.b &&
+    lhs.bg.r == rhs.bg.r && lhs.bg.g == rhs.bg.g && lhs.bg.b == rhs.bg.b;
+}
+
+bool operator!=(Style const& lhs, Style const& rhs) {
+  return !(lhs == rhs);
+}
+
+struct Glyph_pool {
+  using Entry = std::pair<std::string, std::size_t>;
+  static constexpr std::size_t chunk {1024};
+
+  // entries live in chunks that never move, so the output thread can read the
+  // glyphs of a published frame while new ones are interned
+  std::array<std::unique_ptr<std::array<Entry, chunk>>, chunk> value;
+  std::size_t size {0};
+  std::unordered_map<std::string_view, std::uint32_t> index;
+
+  Glyph_pool() {
+    add("", 0);
+    add("\xef\xbf\xbd", 1);
+  }
+
+  Entry& at(std::size_t const id) {
+    return (*value[id / chunk])[id % chunk];
+  }
+
+  std::uint32_t add(std::string_view const str, std::size_t const cols) {
+    if (size == chunk * chunk) {
+      // full, show the replacement character
+      return 1;
+    }
+    if (size % chunk == 0) {
+      value[size / chunk] = std::make_unique<std::array<Entry, chunk>>();
+    }
+    auto const id = static_cast<std::uint32_t>(size++);
+    auto& entry = at(id);
+    entry = Entry(std::string(str), cols);
+    index.emplace(entry.first, id);
+    return id;
+  }
+};
+
+static Glyph_pool& glyph_pool() {
+  static Glyph_pool pool;
+  return pool;
+}
+
+Glyph::Glyph(std::string_view const str) : Glyph(str, text_cols(str)) {
+}
+
+Glyph::Glyph(std::string_view const str, std::size_t const cols) {
+  auto& pool = glyph_pool();
+  if (auto const it = pool.index.find(str); it != pool.index.end()) {
+    id = it->second;
+    return;
+  }
+  id = pool.add(str, cols);
+}
+
+std::string_view Glyph::str() const {
+  return glyph_pool().at(id).first;
+}
+
+std::size_t Glyph::cols() const {
+  return glyph_pool().at(id).second;
+}
+
+std::size_t Glyph::count() {
+  return glyph_pool().size;
+}
+
+bool operator==(Glyph const& lhs, Glyph const& rhs) {
+  return lhs.id == rhs.id;
+}
+
+bool operator!=(Glyph const& lhs, Glyph const& rhs) {
+  return !(lhs == rhs);
+}
+
 // Background -----------------------------------------------------------------------
 
 Background::Background(Ctx ctx) : Scene(ctx) {
@@ -142,7 +266,24 @@ Root::Root(Ctx ctx) : Scene(ctx) {
   _scenes("prompt", std::make_shared<Prompt>(ctx));
   _scenes("board", std::make_shared<Board>(ctx));
   _scenes("snake", std::make_shared<Snake>(ctx));
+  for (std::size_t i = 0; i < _ctx->_stress.bots; ++i) {
+    auto const bot = std::make_shared<Bot>(ctx, i, _ctx->_stress.ai);
+    _scenes("bot-" + std::to_string(i), bot);
+    _bots.emplace_back(bot);
+  }
   _scenes("egg", std::make_shared<Egg>(ctx));
+  // one more egg for every four bots
+  for (std::size_t i = 0; i < _ctx->_stress.bots / 4; ++i) {
+    auto const egg = std::make_shared<Egg>(ctx);
+    egg->_random = true;
+    _scenes("egg-" + std::to_string(i), egg);
+    _eggs.emplace_back(egg);
+  }
+  _scenes("perf", std::make_shared<Perf>(ctx));
+  index();
+
+  // the snake only redraws the cells it moved through
+  _layers.at(Game).retained = true;
 
   _focus = "snake";
 
@@ -180,7 +321,9 @@ void Root::on_winch(Size const& size) {
   }
   _buf.size(_size);
   _scenes.at("background")->on_render(_buf);
-  _scenes.at("board")->on_render(_buf);
+  _scene.board->on_render(_buf);
+  _buf.damage().clear();
+  _dirty = true;
 }
 
 bool Root::on_input(Read::Ctx const& ctx) {
@@ -226,42 +369,33 @@ bool Root::on_read(Read::Key const& ctx) {
           _code.at(8).first == 'b' &&
           _code.at(9).first == 'a'
           ) {
-        auto const snake = std::dynamic_pointer_cast<Snake>(_scenes.at("snake"));
-        snake->rainbow(true);
+        _scene.snake->rainbow(true);
       }
     }
   }
 
   switch (ctx.ch) {
     case Key::Escape: {
-      auto const prompt = std::dynamic_pointer_cast<Prompt>(_scenes.at("prompt"));
-      prompt->_state = Prompt::State::Clear;
+      _scene.prompt->_state = Prompt::State::Clear;
       return true;
     }
     case ':': case ';': {
       _focus = "prompt";
-      auto const snake = std::dynamic_pointer_cast<Snake>(_scenes.at("snake"));
-      snake->_state = Snake::State::Stopped;
-      auto const prompt = std::dynamic_pointer_cast<Prompt>(_scenes.at("prompt"));
-      prompt->_state = Prompt::State::Typing;
+      _scene.snake->_state = Snake::State::Stopped;
+      _scene.prompt->_state = Prompt::State::Typing;
       return true;
     }
-    case 'r': {
-      _scenes.erase("snake");
-      _scenes.erase("egg");
-      _scenes("snake", std::make_shared<Snake>(_ctx));
-      _scenes("egg", std::make_shared<Egg>(_ctx));
-      on_winch(_size);
-      return true;
-    }
-    case 'R': {
-      _scenes.erase("board");
-      _scenes.erase("snake");
-      _scenes.erase("egg");
-      _scenes("board", std::make_shared<Board>(_ctx));
-      _scenes("snake", std::make_shared<Snake>(_ctx));
-      _scenes("egg", std::make_shared<Egg>(_ctx));
+    case 'r': case 'R': {
+      // the scenes start over in place, 'R' also fits the board to the screen again
+      _timer.clear();
+      _timer.start();
+      if (ctx.ch == 'R') {_scene.board->reset();}
+      _scene.snake->reset();
+      _scene.egg->reset();
       on_winch(_size);
+      restart();
+      _timer.stop();
+      _ctx->_perf.restart.add(_timer.time<Tick>());
       return true;
     }
   }
@@ -273,12 +407,26 @@ bool Root::on_read(Read::Key const& ctx) {
 }
 
 bool Root::on_update(Tick const delta) {
-  for (auto const& e : _scenes) {
-    if (e->second->on_update(delta)) {
-      // std::cerr << "update> " << e->first << "\n";
+  bool changed {false};
+  for (auto const& e : _targets) {
+    _timer.clear();
+    _timer.start();
+    if (e.scene->on_update(delta)) {
+      dirty(e.scene->_zidx);
+      changed = true;
     }
+    _timer.stop();
+    e.perf->update.add(_timer.time<Tick>());
   }
-  return true;
+  return changed || _dirty;
+}
+
+Tick Root::deadline() {
+  auto res = Tick::max();
+  for (auto const& e : _targets) {
+    res = std::min(res, e.scene->deadline());
+  }
+  return res;
 }
 
 bool Root::on_render(Buffer& buf) {
@@ -288,15 +436,196 @@ bool Root::on_render(Buffer& buf) {
   //   }
   // }
 
-  buf = _buf;
-  _scenes.at("status")->on_render(buf);
-  _scenes.at("prompt")->on_render(buf);
-  _scenes.at("snake")->on_render(buf);
-  _scenes.at("egg")->on_render(buf);
+  if (_dirty) {
+    // the static layer was redrawn, recompose the whole screen
+    _dirty = false;
+    buf.copy(_buf);
+    buf.damage(Rect(Pos(), _size));
+    _cover.assign(_size.w * _size.h, 0);
+    for (auto& e : _layers) {
+      e.damage.clear();
+      e.dirty = true;
+      e.full = true;
+    }
+  }
+
+  // put back the static cells under each layer to redraw,
+  // a layer sharing one of those cells has to be redrawn as well
+  for (bool more {true}; more;) {
+    more = false;
+    for (std::size_t z = Game; z < _layers.size(); ++z) {
+      auto& layer = _layers.at(z);
+      if (! layer.full) {continue;}
+      for (auto const& rect : layer.damage) {
+        auto const x_end = std::min(rect.pos.x + rect.size.w, _size.w);
+        auto const y_end = std::min(rect.pos.y + rect.size.h, _size.h);
+        for (std::size_t y = rect.pos.y; y < y_end; ++y) {
+          for (std::size_t x = rect.pos.x; x < x_end; ++x) {
+            auto& cover = _cover.at(y * _size.w + x);
+            if (! (cover & (1 << z))) {continue;}
+            for (std::size_t other = Game; other < _layers.size(); ++other) {
+              if ((cover & (1 << other)) && ! _layers.at(other).full) {
+                _layers.at(other).dirty = true;
+                _layers.at(other).full = true;
+                more = true;
+              }
+            }
+            cover = 0;
+            buf.at(Pos(x, y)) = _buf.at(Pos(x, y));
+          }
+        }
+        buf.damage(rect);
+      }
+      layer.damage.clear();
+    }
+  }
+
+  for (std::size_t z = Game; z < _layers.size(); ++z) {
+    auto& layer = _layers.at(z);
+    if (! layer.dirty) {continue;}
+
+    // collect the regions of this layer on their own,
+    // writes under a higher layer still count as the layer lies below it
+    auto& damage = buf.damage();
+    _damage.swap(damage);
+    for (auto const& e : layer.scenes) {
+      _timer.clear();
+      _timer.start();
+      e.scene->on_render(buf);
+      _timer.stop();
+      e.perf->render.add(_timer.time<Tick>());
+    }
+    if (layer.full) {layer.damage.clear();}
+    if (layer.damage.size() + damage.size() > 256) {
+      // too many small regions, walk the whole screen when putting it back
+      layer.damage.assign(1, Rect(Pos(), _size));
+    }
+    layer.damage.insert(layer.damage.end(), damage.begin(), damage.end());
+    layer.dirty = false;
+    layer.full = false;
+
+    for (auto const& rect : damage) {
+      auto const x_end = std::min(rect.pos.x + rect.size.w, _size.w);
+      auto const y_end = std::min(rect.pos.y + rect.size.h, _size.h);
+      for (std::size_t y = rect.pos.y; y < y_end; ++y) {
+        for (std::size_t x = rect.pos.x; x < x_end; ++x) {
+          _cover.at(y * _size.w + x) |= static_cast<std::uint8_t>(1 << z);
+        }
+      }
+    }
+
+    _damage.insert(_damage.end(), damage.begin(), damage.end());
+    _damage.swap(damage);
+    _damage.clear();
+  }
 
   return true;
 }
 
+void Root::dirty() {
+  for (std::size_t z = Game; z < _layers.size(); ++z) {
+    dirty(static_cast<int>(z));
+  }
+}
+
+void Root::dirty(int const zidx) {
+  auto& layer = _layers.at(static_cast<std::size_t>(zidx));
+  layer.dirty = true;
+  // retained scenes track their own changes
+  if (! layer.retained) {layer.full = true;}
+}
+
+bool Root::occupied(Pos const& pos) {
+  return _grid.test(pos);
+}
+
+void Root::follow(Pos const& pos) {
+  if (! _scene.board->follow(pos)) {return;}
+  _scene.board->on_render(_buf);
+  _buf.damage().clear();
+  _dirty = true;
+}
+
+void Root::restart() {
+  // the grid still holds the old snake
+  _grid.size(_grid.size());
+  for (auto const& e : _scene.snake->_sprite) {
+    _grid.set(e.pos);
+  }
+  for (auto const& bot : _bots) {
+    bot->_body.clear();
+    bot->respawn();
+  }
+  for (auto const& egg : _eggs) {
+    egg->spawn();
+  }
+}
+
+std::uint32_t Root::hash() const {
+  // fnv-1a folded to 32 bits
+  std::uint64_t res {0xcbf29ce484222325};
+  auto const add = [&](std::uint64_t val) {
+    for (int i = 0; i < 8; ++i) {
+      res ^= val & 0xff;
+      res *= 0x100000001b3;
+      val >>= 8;
+    }
+  };
+  auto const& snake = *_scene.snake;
+  add(snake._sprite.size());
+  for (auto const& e : snake._sprite) {
+    add(e.pos.x);
+    add(e.pos.y);
+  }
+  add(snake._ext);
+  add(_scene.egg->_pos.x);
+  add(_scene.egg->_pos.y);
+  for (auto const& egg : _eggs) {
+    add(egg->_pos.x);
+    add(egg->_pos.y);
+  }
+  for (auto const& bot : _bots) {
+    add(bot->_body.size());
+    for (auto const& e : bot->_body) {
+      add(e.x);
+      add(e.y);
+    }
+  }
+  add(_grid.count());
+  return static_cast<std::uint32_t>(res ^ (res >> 32));
+}
+
+void Root::erase(Buffer& buf, Pos const& pos, int const zidx) {
+  if (pos.x >= _size.w || pos.y >= _size.h) {return;}
+  auto const y = _size.h - pos.y - 1;
+  auto& cover = _cover.at(y * _size.w + pos.x);
+  auto const bit = static_cast<std::uint8_t>(1 << zidx);
+  if (! (cover & bit)) {return;}
+  cover &= static_cast<std::uint8_t>(~bit);
+  // a higher layer still draws over the cell
+  if (cover) {return;}
+  buf.at(Pos(pos.x, y)) = _buf.at(Pos(pos.x, y));
+  // goes with the regions of the layers below, it is no longer part of this one
+  _damage.emplace_back(Pos(pos.x, y), Size(1, 1));
+}
+
+void Root::index() {
+  _scene.board = dynamic_cast<Board*>(_scenes.at("board").get());
+  _scene.snake = dynamic_cast<Snake*>(_scenes.at("snake").get());
+  _scene.egg = dynamic_cast<Egg*>(_scenes.at("egg").get());
+  _scene.prompt = dynamic_cast<Prompt*>(_scenes.at("prompt").get());
+  _targets.clear();
+  for (auto& e : _layers) {e.scenes.clear();}
+  for (auto const& e : _scenes) {
+    // map nodes stay put, the timings of a replaced scene carry over
+    Target const target {e->second.get(), &_ctx->_perf.scenes[e->first]};
+    _targets.emplace_back(target);
+    if (e->second->_zidx != Static) {
+      _layers.at(static_cast<std::size_t>(e->second->_zidx)).scenes.emplace_back(target);
+    }
+  }
+}
+
 // Board -----------------------------------------------------------------------
 
 Board::Board(Ctx ctx) : Scene(ctx) {
@@ -306,16 +635,49 @@ Board::~Board() {
 }
 
 void Board::on_winch(Size const& size) {
+  auto& grid = _ctx->_root->_grid;
   if (_init) {
     _init = false;
     _size = Size(size.w, size.h - 2);
     if (_size.w % 2) {--_size.w;}
+    // the snakes move inside the border
+    grid.size(_ctx->_world.w ? _ctx->_world : Size((_size.w - 3) / 2, _size.h - 2));
+    _camera = Pos();
   }
+  if (_ctx->_world.w) {
+    // the border takes the screen, or hugs a board smaller than it
+    _size = Size(std::min(size.w - size.w % 2, grid.size().w * 2 + 4), std::min(size.h - 2, grid.size().h + 2));
+  }
+  _view = Size((_size.w - 3) / 2, _size.h - 2);
   _pos = Pos((size.w / 2) - (_size.w / 2), (size.h / 2) - (_size.h / 2));
   if (_pos.x % 2) {--_pos.x;}
   if (_pos.y % 2) {++_pos.y;}
 }
 
+void Board::reset() {
+  _init = true;
+}
+
+bool Board::visible(Pos const& pos) const {
+  // left or below the view wraps around
+  return (pos.x - _camera.x) / 2 < _view.w && pos.y - _camera.y < _view.h;
+}
+
+bool Board::follow(Pos const& pos) {
+  auto const& world = _ctx->_root->_grid.size();
+  // the view jumps to centre pos once it nears an edge, so most ticks still only draw what moved
+  auto const axis = [](std::size_t const p, std::size_t const cam, std::size_t const view, std::size_t const extent) -> std::size_t {
+    if (extent <= view) {return 0;}
+    auto const margin = view / 4;
+    if (p >= cam + margin && p + margin < cam + view) {return std::min(cam, extent - view);}
+    return std::min(p > view / 2 ? p - view / 2 : 0, extent - view);
+  };
+  Pos const camera {axis(pos.x / 2, _camera.x / 2, _view.w, world.w) * 2, axis(pos.y, _camera.y, _view.h, world.h)};
+  if (camera.x == _camera.x && camera.y == _camera.y) {return false;}
+  _camera = camera;
+  return true;
+}
+
 bool Board::on_input(Read::Ctx const& ctx) {
   return false;
 }
@@ -325,7 +687,6 @@ bool Board::on_update(Tick const delta) {
 }
 
 bool Board::on_render(Buffer& buf) {
-  bool swap {false};
   for (std::size_t y = 0; y < _size.h; ++y) {
     if (y == 0) {
       // bottom
@@ -333,15 +694,15 @@ bool Board::on_render(Buffer& buf) {
         buf.cursor(Pos(_pos.x + x, _pos.y + y));
         if (x == 0) {
           // outer left
-          buf(Cell{this, 0, _style, " └"});
+          buf(Span{this, _zidx, _style, " └"});
         }
         else if (x == _size.w - 2) {
           // outer right
-          buf(Cell{this, 0, _style, "┘ "});
+          buf(Span{this, _zidx, _style, "┘ "});
         }
         else {
           // inner
-          buf(Cell{this, 0, _style, "──"});
+          buf(Span{this, _zidx, _style, "──"});
         }
       }
     }
@@ -351,15 +712,15 @@ bool Board::on_render(Buffer& buf) {
         buf.cursor(Pos(_pos.x + x, _pos.y + y));
         if (x == 0) {
           // outer left
-          buf(Cell{this, 0, _style, " ┌"});
+          buf(Span{this, _zidx, _style, " ┌"});
         }
         else if (x == _size.w - 2) {
           // outer right
-          buf(Cell{this, 0, _style, "┐ "});
+          buf(Span{this, _zidx, _style, "┐ "});
         }
         else {
           // inner
-          buf(Cell{this, 0, _style, "──"});
+          buf(Span{this, _zidx, _style, "──"});
         }
       }
     }
@@ -369,32 +730,30 @@ bool Board::on_render(Buffer& buf) {
         buf.cursor(Pos(_pos.x + x, _pos.y + y));
         if (x == 0) {
           // outer left
-          buf(Cell{this, 0, _style, " │"});
+          buf(Span{this, _zidx, _style, " │"});
         }
         else if (x == _size.w - 2) {
           // outer right
-          buf(Cell{this, 0, _style, "│ "});
+          buf(Span{this, _zidx, _style, "│ "});
         }
         else {
-          // inner
-          if (swap) {
-            buf(Cell{this, 0, _block1, "  "});
+          // inner, the pattern stays with the board as the view moves
+          if ((_camera.x / 2 + x / 2 - 1 + _camera.y + y - 1) % 2) {
+            buf(Span{this, _zidx, _block1, "  "});
           }
           else {
-            buf(Cell{this, 0, _block2, "  "});
+            buf(Span{this, _zidx, _block2, "  "});
           }
-          swap = !swap;
         }
       }
     }
-    if ((_size.w / 2) % 2 == 0) {swap = !swap;}
   }
   return false;
 }
 
 // Snake -----------------------------------------------------------------------
 
-Snake::Snake(Ctx ctx) : Scene(ctx) {
+Snake::Snake(Ctx ctx) : Scene(ctx, Root::Game) {
   auto const& _env = _ctx->_env;
 
   (*_env)["pause"] = Val{Fun{str_lst("()"), [&](auto e) -> Xpr {
@@ -555,6 +914,11 @@ Snake::Snake(Ctx ctx) : Scene(ctx) {
   (*_env)["snake-coil"] = Val{Fun{str_lst("()"), [&](auto e) -> Xpr {
     if (_sprite.size() > 3) {
       _ext += _sprite.size() - 3;
+      auto& grid = _ctx->_root->_grid;
+      for (auto it = std::next(_sprite.begin(), 3); it != _sprite.end(); ++it) {
+        grid.reset(it->pos);
+        _drawn.erase.emplace_back(it->pos);
+      }
       _sprite.erase(std::next(_sprite.begin(), 3), _sprite.end());
     }
     return sym_xpr("T");
@@ -563,6 +927,8 @@ Snake::Snake(Ctx ctx) : Scene(ctx) {
   (*_env)["snake-reverse"] = Val{Fun{str_lst("()"), [&](auto e) -> Xpr {
     _dir.clear();
     std::reverse(_sprite.begin(), _sprite.end());
+    _drawn.moved = _sprite.size();
+    _ctx->_root->follow(_sprite.front().pos);
     // TODO set direction after reversal
     return sym_xpr("T");
   }}, _env, Val::evaled};
@@ -605,7 +971,12 @@ Snake::Snake(Ctx ctx) : Scene(ctx) {
         }
         else {
           _ext = 0;
-          _sprite.erase(std::next(_sprite.begin(), size), _sprite.end());
+          auto& grid = _ctx->_root->_grid;
+          for (auto it = std::next(_sprite.begin(), static_cast<long>(size)); it != _sprite.end(); ++it) {
+            grid.reset(it->pos);
+            _drawn.erase.emplace_back(it->pos);
+          }
+          _sprite.erase(std::next(_sprite.begin(), static_cast<long>(size)), _sprite.end());
         }
         return x;
       }
@@ -642,13 +1013,18 @@ Snake::~Snake() {
 }
 
 void Snake::on_winch(Size const& size) {
+  auto& root = *_ctx->_root;
   if (_init) {
     _init = false;
-    auto const& board = std::dynamic_pointer_cast<Root>(_ctx->_root)->_scenes.at("board");
-    auto x = (board->_size.w - 5) / 2;
-    if (x % 2) {x -= 1;}
+    auto const x = (root._grid.size().w - 1) / 2 * 2;
+    // a snake filling the board, only a rainbow snake crossing itself grows past it,
+    // on a board far larger than the screen the ring grows with the snake instead
+    _sprite.reserve(std::min(root._grid.size().w * root._grid.size().h, std::size_t {1} << 16) + 1);
     _sprite.emplace_front(Block{Pos{x, 0}, &_style.head, _text.head.at(Dir::Up)});
+    root._grid.set(_sprite.front().pos);
   }
+  // the static layer is drawn after every scene took the new size
+  root._scene.board->follow(_sprite.front().pos);
   _size = size;
 }
 
@@ -685,9 +1061,44 @@ bool Snake::on_input(Read::Ctx const& ctx) {
   return false;
 }
 
+void Snake::reset() {
+  // the member defaults apart from the key bindings, the head is placed again on the next winch
+  _sprite.clear();
+  _style = decltype(_style)();
+  _text = decltype(_text)();
+  _drawn.erase.clear();
+  _drawn.moved = 0;
+  _drawn.head = Pos();
+  _drawn.special = 0;
+  _init = true;
+  _dir_prev = Up;
+  _dir.clear();
+  _state = Stopped;
+  _ext = 2;
+  _delta = 0ms;
+  _interval = 300ms;
+  rainbow(false);
+  _hit_wall = false;
+  _hit_wall_egg = true;
+  _hit_wall_portal = false;
+  _hit_body = true;
+  _special_time = 0ms;
+  _special_delta = 0ms;
+  _special_interval = _interval / 2;
+  _color = OB::Color();
+  _state_eyes_idx = 0;
+  _state_eyes.front().second = 3000ms;
+  _blink_delta = 0ms;
+  _blink_interval = 3000ms;
+}
+
 bool Snake::on_update(Tick const delta) {
+  bool changed {false};
+
   // special animation
   if (_special != Special::Normal) {
+    // the rainbow colours also advance on each render
+    changed = true;
     if (_ctx->_time - _special_time > 20000ms) {
       rainbow(false);
     }
@@ -714,11 +1125,12 @@ bool Snake::on_update(Tick const delta) {
   {
     _blink_delta += delta;
     if (_blink_delta >= _blink_interval) {
+      changed = true;
       while (_blink_delta >= _blink_interval) {
         _blink_delta -= _blink_interval;
         if (++_state_eyes_idx >= _state_eyes.size()) {
           _state_eyes_idx = 0;
-          _state_eyes.front().second = static_cast<Tick>(random_range(4, 8) * 1000000000);
+          _state_eyes.front().second = static_cast<Tick>(_ctx->_random.range(4, 8) * 1000000000);
         }
         _blink_interval = _state_eyes.at(_state_eyes_idx).second;
       }
@@ -728,65 +1140,114 @@ bool Snake::on_update(Tick const delta) {
   switch (_state) {
     case Stopped: {
       state_stopped();
-      return false;
+      break;
     }
     case Moving: case Fixed: {
       _delta += delta;
       if (_delta >= _interval) {
+        // a fixed snake only moves with a queued direction
+        if (_state == Moving || ! _dir.empty()) {changed = true;}
         while (_delta >= _interval) {
           _delta -= _interval;
           state_moving();
         }
       }
-      return true;
+      break;
     }
   }
 
-  return false;
+  _ctx->_root->follow(_sprite.front().pos);
+
+  return changed;
+}
+
+Tick Snake::deadline() {
+  if (_special != Special::Normal) {return 0ms;}
+  auto res = _blink_interval - _blink_delta;
+  if (_state == Moving || (_state == Fixed && ! _dir.empty())) {
+    res = std::min(res, _interval - _delta);
+  }
+  return std::max(res, Tick(0ms));
 }
 
 bool Snake::on_render(Buffer& buf) {
-  auto const& board = std::dynamic_pointer_cast<Root>(_ctx->_root)->_scenes.at("board");
+  auto& root = *_ctx->_root;
+  auto const& board = root._scene.board;
+  // board to screen, blocks outside the view are skipped
+  auto const x = board->_pos.x + 2 - board->_camera.x;
+  auto const y = board->_pos.y + 1 - board->_camera.y;
+  auto& head = _sprite.front();
+
+  // the layer keeps the last frame unless the compositor put it back,
+  // the rainbow colours change every block so those frames draw all of them
+  bool const full {root._layers.at(static_cast<std::size_t>(_zidx)).full || _special != Special::Normal || _drawn.special != Special::Normal};
+
+  // vacated blocks and the border guides of the last head go back to the board
+  for (auto const& e : _drawn.erase) {
+    if (! board->visible(e)) {continue;}
+    root.erase(buf, Pos(e.x + x, e.y + y), _zidx);
+    root.erase(buf, Pos(e.x + x + 1, e.y + y), _zidx);
+  }
+  if ((_drawn.head.x != head.pos.x || _drawn.head.y != head.pos.y) && board->visible(_drawn.head)) {
+    root.erase(buf, Pos(_drawn.head.x + x, board->_pos.y + board->_size.h - 1), _zidx);
+    root.erase(buf, Pos(_drawn.head.x + x + 1, board->_pos.y + board->_size.h - 1), _zidx);
+    root.erase(buf, Pos(_drawn.head.x + x, board->_pos.y), _zidx);
+    root.erase(buf, Pos(_drawn.head.x + x + 1, board->_pos.y), _zidx);
+    root.erase(buf, Pos(board->_pos.x + 1, _drawn.head.y + y), _zidx);
+    root.erase(buf, Pos(board->_pos.x + board->_size.w - 2, _drawn.head.y + y), _zidx);
+  }
 
   if (_special != Special::Normal) {
     if (_special & Rainbow) {
       if (_special & Flicker) {
         for (auto it = _sprite.rbegin(); it != _sprite.rend(); ++it) {
-          buf.cursor(Pos(it->pos.x + board->_pos.x + 2, it->pos.y + board->_pos.y + 1));
-          buf(Cell{this, 0, *it->style, std::string(it->value)});
+          if (! board->visible(it->pos)) {continue;}
+          buf.cursor(Pos(it->pos.x + x, it->pos.y + y));
+          buf(Span{this, _zidx, *it->style, it->value});
         }
       }
       else {
         double const step {-100.0 / _sprite.size()};
         for (auto it = _sprite.rbegin(); it != _sprite.rend(); ++it) {
-          buf.cursor(Pos(it->pos.x + board->_pos.x + 2, it->pos.y + board->_pos.y + 1));
-          auto const rgb = _color.rgb();
-          buf(Cell{this, 0, _style.head.type, _style.head.attr, _style.head.fg, Color(static_cast<std::uint8_t>(rgb.r), static_cast<std::uint8_t>(rgb.g), static_cast<std::uint8_t>(rgb.b)), std::string(it->value)});
+          if (board->visible(it->pos)) {
+            buf.cursor(Pos(it->pos.x + x, it->pos.y + y));
+            auto const rgb = _color.rgb();
+            buf(Span{this, _zidx, _style.head.type, _style.head.attr, _style.head.fg, Color(static_cast<std::uint8_t>(rgb.r), static_cast<std::uint8_t>(rgb.g), static_cast<std::uint8_t>(rgb.b)), it->value});
+          }
           _color.step(step);
         }
       }
     }
   }
   else {
-    for (auto it = _sprite.rbegin(); it != _sprite.rend(); ++it) {
-      buf.cursor(Pos(it->pos.x + board->_pos.x + 2, it->pos.y + board->_pos.y + 1));
-      buf(Cell{this, 0, *it->style, std::string(it->value)});
+    // only the new head blocks and the neck behind them changed
+    auto const size = full ? _sprite.size() : std::min(_drawn.moved + 1, _sprite.size());
+    for (auto it = std::make_reverse_iterator(std::next(_sprite.begin(), static_cast<long>(size))); it != _sprite.rend(); ++it) {
+      if (! board->visible(it->pos)) {continue;}
+      buf.cursor(Pos(it->pos.x + x, it->pos.y + y));
+      buf(Span{this, _zidx, *it->style, it->value});
     }
   }
 
-  auto& head = _sprite.front();
+  _drawn.erase.clear();
+  _drawn.moved = 0;
+  _drawn.head = head.pos;
+  _drawn.special = _special;
+
+  // a head outside the view has no guides
+  if (! board->visible(head.pos)) {return false;}
 
   // apply blink state
-  _state_eyes.at(_state_eyes_idx).first(buf.col(Pos(head.pos.x + board->_pos.x + 2, head.pos.y + board->_pos.y + 1)));
-  _state_eyes.at(_state_eyes_idx).first(buf.col(Pos(head.pos.x + board->_pos.x + 3, head.pos.y + board->_pos.y + 1)));
+  if (auto const cell = buf.col(Pos(head.pos.x + x, head.pos.y + y), _zidx)) {_state_eyes.at(_state_eyes_idx).first(*cell);}
+  if (auto const cell = buf.col(Pos(head.pos.x + x + 1, head.pos.y + y), _zidx)) {_state_eyes.at(_state_eyes_idx).first(*cell);}
 
-  buf.col(Pos(head.pos.x + board->_pos.x + 2, board->_pos.y + board->_size.h - 1)).style.fg = head.style->bg;
-  buf.col(Pos(head.pos.x + board->_pos.x + 3, board->_pos.y + board->_size.h - 1)).style.fg = head.style->bg;
-  buf.col(Pos(head.pos.x + board->_pos.x + 2, board->_pos.y)).style.fg = head.style->bg;
-  buf.col(Pos(head.pos.x + board->_pos.x + 3, board->_pos.y)).style.fg = head.style->bg;
+  if (auto const cell = buf.col(Pos(head.pos.x + x, board->_pos.y + board->_size.h - 1), _zidx)) {cell->style.fg = head.style->bg;}
+  if (auto const cell = buf.col(Pos(head.pos.x + x + 1, board->_pos.y + board->_size.h - 1), _zidx)) {cell->style.fg = head.style->bg;}
+  if (auto const cell = buf.col(Pos(head.pos.x + x, board->_pos.y), _zidx)) {cell->style.fg = head.style->bg;}
+  if (auto const cell = buf.col(Pos(head.pos.x + x + 1, board->_pos.y), _zidx)) {cell->style.fg = head.style->bg;}
 
-  buf.col(Pos(board->_pos.x + 1, head.pos.y + board->_pos.y + 1)).style.fg = head.style->bg;
-  buf.col(Pos(board->_pos.x + board->_size.w - 2, head.pos.y + board->_pos.y + 1)).style.fg = head.style->bg;
+  if (auto const cell = buf.col(Pos(board->_pos.x + 1, head.pos.y + y), _zidx)) {cell->style.fg = head.style->bg;}
+  if (auto const cell = buf.col(Pos(board->_pos.x + board->_size.w - 2, head.pos.y + y), _zidx)) {cell->style.fg = head.style->bg;}
 
   return false;
 }
@@ -891,51 +1352,44 @@ void Snake::state_moving() {
     }
   }
 
+  auto& root = *_ctx->_root;
+  auto const& world = root._grid.size();
+  auto& egg = *root._scene.egg;
+
   // hit wall
   if (_hit_wall) {
-    bool hit_wall {false};
-    auto const& board = std::dynamic_pointer_cast<Root>(_ctx->_root)->_scenes.at("board");
-    if (head.x < 0 || head.x >= board->_size.w - 4 ||
-        head.y < 0 || head.y >= board->_size.h - 2) {
-      hit_wall = true;
-    }
-    if (hit_wall) {
+    if (! root._grid.inside(head)) {
       // std::cerr << "collide> " << "snake -> wall" << "\n";
       _dir.clear();
       return;
     }
   }
   else if (_hit_wall_portal) {
-    auto const& board = std::dynamic_pointer_cast<Root>(_ctx->_root)->_scenes.at("board");
     if (static_cast<long>(head.x) < 0) {
-      head.x = board->_size.w - 5;
-      if (head.x % 2) {head.x -= 1;}
+      head.x = (world.w - 1) * 2;
     }
-    else if (head.x >= board->_size.w - 4) {
+    else if (head.x / 2 >= world.w) {
       head.x = 0;
     }
     else if (static_cast<long>(head.y) < 0) {
-      head.y = board->_size.h - 3;
+      head.y = world.h - 1;
     }
-    else if (head.y >= board->_size.h - 2) {
+    else if (head.y >= world.h) {
       head.y = 0;
     }
   }
   else if (_hit_wall_egg) {
     bool hit_wall {false};
-    auto const& egg = std::dynamic_pointer_cast<Root>(_ctx->_root)->_scenes.at("egg");
-    auto const& board = std::dynamic_pointer_cast<Root>(_ctx->_root)->_scenes.at("board");
     if (static_cast<long>(head.x) < 0) {
-      if (head.y == egg->_pos.y) {
-        head.x = board->_size.w - 5;
-        if (head.x % 2) {head.x -= 1;}
+      if (head.y == egg._pos.y) {
+        head.x = (world.w - 1) * 2;
       }
       else {
         hit_wall = true;
       }
     }
-    else if (head.x >= board->_size.w - 4) {
-      if (head.y == egg->_pos.y) {
+    else if (head.x / 2 >= world.w) {
+      if (head.y == egg._pos.y) {
         head.x = 0;
       }
       else {
@@ -943,15 +1397,15 @@ void Snake::state_moving() {
       }
     }
     else if (static_cast<long>(head.y) < 0) {
-      if (head.x == egg->_pos.x) {
-        head.y = board->_size.h - 3;
+      if (head.x == egg._pos.x) {
+        head.y = world.h - 1;
       }
       else {
         hit_wall = true;
       }
     }
-    else if (head.y >= board->_size.h - 2) {
-      if (head.x == egg->_pos.x) {
+    else if (head.y >= world.h) {
+      if (head.x == egg._pos.x) {
         head.y = 0;
       }
       else {
@@ -968,12 +1422,8 @@ void Snake::state_moving() {
   // hit snake
   bool hit_snake {false};
   if (_hit_body) {
-    for (auto const& cell : _sprite) {
-      if (head.x == cell.pos.x && head.y == cell.pos.y) {
-        hit_snake = true;
-        break;
-      }
-    }
+    // the body or a bot
+    hit_snake = root.occupied(head);
     if (hit_snake) {
       // std::cerr << "collide> " << "snake -> snake" << "\n";
       _dir.clear();
@@ -994,8 +1444,7 @@ void Snake::state_moving() {
 
   // hit egg
   bool hit_egg {false};
-  auto& egg = *std::dynamic_pointer_cast<Egg>(std::dynamic_pointer_cast<Root>(_ctx->_root)->_scenes.at("egg"));
-  if (head.x == egg._pos.x && head.y == egg._pos.y) {
+  if (! egg._full && head.x == egg._pos.x && head.y == egg._pos.y) {
     hit_egg = true;
   }
 
@@ -1004,12 +1453,16 @@ void Snake::state_moving() {
       _ext -= 1;
     }
     else {
+      root._grid.reset(_sprite.back().pos);
+      _drawn.erase.emplace_back(_sprite.back().pos);
       _sprite.pop_back();
     }
   }
 
   _dir_prev = dir;
   _sprite.emplace_front(Block{head, &_style.head, _text.head.at(dir)});
+  root._grid.set(head);
+  ++_drawn.moved;
   _sprite.at(1).style = &_style.body.at(_style.idx);
   _sprite.at(1).value = _text.body;
   if (++_style.idx >= _style.body.size()) {_style.idx = 0;}
@@ -1058,12 +1511,9 @@ void Snake::rainbow(bool const val) {
 
 // Egg -----------------------------------------------------------------------
 
-Egg::Egg(Ctx ctx) : Scene(ctx) {
+Egg::Egg(Ctx ctx) : Scene(ctx, Root::Item) {
   _interval = std::chrono::duration_cast<Tick>((_duration / 2) / _style.max);
-  _style.color = _style.color_map.at(_style.type);
-  _style.color.lum(30);
-  auto const rgb = _style.color.rgb();
-  _style.style.bg = Color(rgb.r, rgb.g, rgb.b);
+  style_normal();
 }
 
 Egg::~Egg() {
@@ -1072,18 +1522,30 @@ Egg::~Egg() {
 void Egg::on_winch(Size const& size) {
   if (_init) {
     _init = false;
-    auto const& board = *std::dynamic_pointer_cast<Root>(_ctx->_root)->_scenes.at("board");
-    auto x = (board._size.w - 5) / 2;
-    if (x % 2) {x -= 1;}
-    _pos = Pos(x, (board._size.h - 2) / 2);
+    if (_random) {
+      spawn();
+      return;
+    }
+    auto const& world = _ctx->_root->_grid.size();
+    _pos = Pos((world.w - 1) / 2 * 2, world.h / 2);
   }
 }
 
+void Egg::reset() {
+  style_normal();
+  _init = true;
+  _delta = 0ms;
+  count = 0;
+  _full = false;
+}
+
 bool Egg::on_input(Read::Ctx const& ctx) {
   return false;
 }
 
 bool Egg::on_update(Tick const delta) {
+  // board full, try again now that the snakes have moved
+  if (_full && ! spawn()) {return false;}
   _delta += delta;
   if (_delta >= _interval) {
     while (_delta >= _interval) {
@@ -1113,43 +1575,52 @@ bool Egg::on_update(Tick const delta) {
   return false;
 }
 
+Tick Egg::deadline() {
+  return std::max(_interval - _delta, Tick(0ms));
+}
+
 bool Egg::on_render(Buffer& buf) {
-  auto const& board = std::dynamic_pointer_cast<Root>(_ctx->_root)->_scenes.at("board");
+  if (_full) {return false;}
+  auto const& board = _ctx->_root->_scene.board;
+  auto const x = board->_pos.x + 2 - board->_camera.x;
+  auto const y = board->_pos.y + 1 - board->_camera.y;
+  // the guides still mark an egg outside the view on its row or column
+  bool const col {(_pos.x - board->_camera.x) / 2 < board->_view.w};
+  bool const row {_pos.y - board->_camera.y < board->_view.h};
 
   // egg
-  buf.cursor(Pos(_pos.x + board->_pos.x + 2, _pos.y + board->_pos.y + 1));
-  buf(Cell{this, 0, _style.style, _text});
+  if (col && row) {
+    buf.cursor(Pos(_pos.x + x, _pos.y + y));
+    buf(Span{this, _zidx, _style.style, _text});
+  }
 
   // border x-axis
-  buf.col(Pos(_pos.x + board->_pos.x + 2, board->_pos.y + board->_size.h - 1)).style.fg = _style.style.bg;
-  buf.col(Pos(_pos.x + board->_pos.x + 3, board->_pos.y + board->_size.h - 1)).style.fg = _style.style.bg;
-  buf.col(Pos(_pos.x + board->_pos.x + 2, board->_pos.y)).style.fg = _style.style.bg;
-  buf.col(Pos(_pos.x + board->_pos.x + 3, board->_pos.y)).style.fg = _style.style.bg;
+  if (col) {
+    if (auto const cell = buf.col(Pos(_pos.x + x, board->_pos.y + board->_size.h - 1), _zidx)) {cell->style.fg = _style.style.bg;}
+    if (auto const cell = buf.col(Pos(_pos.x + x + 1, board->_pos.y + board->_size.h - 1), _zidx)) {cell->style.fg = _style.style.bg;}
+    if (auto const cell = buf.col(Pos(_pos.x + x, board->_pos.y), _zidx)) {cell->style.fg = _style.style.bg;}
+    if (auto const cell = buf.col(Pos(_pos.x + x + 1, board->_pos.y), _zidx)) {cell->style.fg = _style.style.bg;}
+  }
 
   // border y-axis
-  buf.col(Pos(board->_pos.x + 1, _pos.y + board->_pos.y + 1)).style.fg = _style.style.bg;
-  buf.col(Pos(board->_pos.x + board->_size.w - 2, _pos.y + board->_pos.y + 1)).style.fg = _style.style.bg;
+  if (row) {
+    if (auto const cell = buf.col(Pos(board->_pos.x + 1, _pos.y + y), _zidx)) {cell->style.fg = _style.style.bg;}
+    if (auto const cell = buf.col(Pos(board->_pos.x + board->_size.w - 2, _pos.y + y), _zidx)) {cell->style.fg = _style.style.bg;}
+  }
 
   return true;
 }
 
-void Egg::spawn() {
-  // TODO handle when egg can't spawn anywhere
-  auto const& board = *std::dynamic_pointer_cast<Board>(std::dynamic_pointer_cast<Root>(_ctx->_root)->_scenes.at("board"));
-  auto& snake = *std::dynamic_pointer_cast<Snake>(std::dynamic_pointer_cast<Root>(_ctx->_root)->_scenes.at("snake"));
-  auto const is_valid = [&]() {
-    for (auto const& e : snake._sprite) {
-      if (_pos.x == e.pos.x && _pos.y == e.pos.y) {return false;}
-    }
-    return true;
-  };
-  do {
-    _pos = {random_range(0, board._size.w - 5), random_range(0, board._size.h - 3)};
-    if (_pos.x % 2) {_pos.x -= 1;}
-  }
-  while (!is_valid());
+bool Egg::spawn() {
+  auto& root = *_ctx->_root;
+  auto const pos = root._grid.random(_ctx->_random);
+  // moved outside of its own update
+  root.dirty(_zidx);
+  _full = ! pos;
+  if (_full) {return false;}
+  _pos = *pos;
 
-  if (++count % 10 == 0 || random_range(0, 100) < 8) {
+  if (++count % 10 == 0 || _ctx->_random.range(0, 100) < 8) {
     _style.type = Styles::Rainbow;
     _delta = 0ms;
     _style.idx = 0;
@@ -1167,11 +1638,233 @@ void Egg::spawn() {
 
   auto const rgb = _style.color.rgb();
   _style.style.bg = Color(rgb.r, rgb.g, rgb.b);
+
+  return true;
+}
+
+void Egg::style_normal() {
+  _style.type = Styles::Normal;
+  _style.dir = Styles::Lighten;
+  _style.idx = 0;
+  _style.color = _style.color_map.at(_style.type);
+  _style.color.lum(30);
+  auto const rgb = _style.color.rgb();
+  _style.style.bg = Color(rgb.r, rgb.g, rgb.b);
+}
+
+// Bot -----------------------------------------------------------------------
+
+Bot::Bot(Ctx ctx, std::size_t const idx, Ai const ai) : Scene(ctx, Root::Game), _ai {ai} {
+  // spread the colours around the hue circle starting from the player
+  OB::Color color {"#43c7c3"};
+  color.hue(std::fmod(color.hue() + 61.8 * static_cast<double>(idx + 1), 100.0));
+  auto rgb = color.rgb();
+  _style.body.bg = Color(rgb.r, rgb.g, rgb.b);
+  color.lum(color.lum() + 15);
+  rgb = color.rgb();
+  _style.head.bg = Color(rgb.r, rgb.g, rgb.b);
+
+  // stagger the bots so they do not all step on the same tick
+  _delta = _interval * static_cast<Tick::rep>(idx % 10) / 10;
+}
+
+Bot::~Bot() {
+}
+
+void Bot::on_winch(Size const& size) {
+  if (_init) {
+    _init = false;
+    respawn();
+  }
+  _size = size;
+}
+
+bool Bot::on_input(Read::Ctx const& ctx) {
+  return false;
+}
+
+bool Bot::on_update(Tick const delta) {
+  bool changed {false};
+  _delta += delta;
+  while (_delta >= _interval) {
+    _delta -= _interval;
+    step();
+    changed = true;
+  }
+  return changed;
+}
+
+Tick Bot::deadline() {
+  return std::max(_interval - _delta, Tick(0ms));
+}
+
+bool Bot::on_render(Buffer& buf) {
+  auto& root = *_ctx->_root;
+  auto const& board = root._scene.board;
+  auto const x = board->_pos.x + 2 - board->_camera.x;
+  auto const y = board->_pos.y + 1 - board->_camera.y;
+
+  // shares the retained layer with the snake, only the new head and neck are drawn
+  for (auto const& e : _drawn.erase) {
+    if (! board->visible(e)) {continue;}
+    root.erase(buf, Pos(e.x + x, e.y + y), _zidx);
+    root.erase(buf, Pos(e.x + x + 1, e.y + y), _zidx);
+  }
+  auto const size = root._layers.at(static_cast<std::size_t>(_zidx)).full ? _body.size() : std::min(_drawn.moved + 1, _body.size());
+  for (auto i = size; i-- > 0;) {
+    auto const& e = _body.at(i);
+    if (! board->visible(e)) {continue;}
+    buf.cursor(Pos(e.x + x, e.y + y));
+    buf(Span{this, _zidx, i ? _style.body : _style.head, _text});
+  }
+  _drawn.erase.clear();
+  _drawn.moved = 0;
+
+  return false;
+}
+
+void Bot::step() {
+  if (_body.empty()) {
+    respawn();
+    return;
+  }
+
+  auto& root = *_ctx->_root;
+  auto& egg = *root._scene.egg;
+  auto const head = _body.front();
+
+  // nearest egg of the pool in board steps
+  auto const dist = [](Pos const& a, Pos const& b) {
+    return (a.x > b.x ? a.x - b.x : b.x - a.x) / 2 + (a.y > b.y ? a.y - b.y : b.y - a.y);
+  };
+  auto target = egg._pos;
+  for (auto const& e : root._eggs) {
+    if (dist(head, e->_pos) < dist(head, target)) {target = e->_pos;}
+  }
+
+  std::optional<Pos> next;
+  if (_ai == Bfs) {next = bfs(head);}
+  if (! next) {next = greedy(head, target);}
+  if (! next) {
+    // boxed in, start over somewhere else
+    respawn();
+    return;
+  }
+
+  if (_ext) {
+    _ext -= 1;
+  }
+  else {
+    root._grid.reset(_body.back());
+    _drawn.erase.emplace_back(_body.back());
+    _body.pop_back();
+  }
+  _body.emplace_front(*next);
+  root._grid.set(*next);
+  ++_drawn.moved;
+
+  // hit egg
+  auto const eat = [&](Egg& e) {
+    if (! e._full && next->x == e._pos.x && next->y == e._pos.y) {
+      e.spawn();
+      _ext += 2;
+    }
+  };
+  eat(egg);
+  for (auto const& e : root._eggs) {eat(*e);}
+}
+
+std::optional<Pos> Bot::greedy(Pos const& head, Pos const& egg) {
+  auto& root = *_ctx->_root;
+  std::optional<Pos> res;
+  std::size_t best {0};
+  for (auto const& e : {Pos(head.x - 2, head.y), Pos(head.x + 2, head.y), Pos(head.x, head.y - 1), Pos(head.x, head.y + 1)}) {
+    if (! root._grid.inside(e) || root.occupied(e)) {continue;}
+    auto const val = (e.x > egg.x ? e.x - egg.x : egg.x - e.x) / 2 + (e.y > egg.y ? e.y - egg.y : egg.y - e.y);
+    if (! res || val < best) {
+      res = e;
+      best = val;
+    }
+  }
+  return res;
+}
+
+std::optional<Pos> Bot::bfs(Pos const& head) {
+  auto& root = *_ctx->_root;
+  auto const& grid = root._grid;
+
+  // a board fitted to the screen is searched whole, on one set with '--world' the search covers
+  // a window around the head at least the size of the view, eggs past it are left to greedy
+  auto const& view = root._scene.board->_view;
+  auto const reach = _ctx->_world.w ? std::max({std::size_t {32}, view.w / 2, view.h / 2}) : std::max(grid.size().w, grid.size().h);
+  auto const cols = std::min(grid.size().w, reach * 2 + 1);
+  auto const rows = std::min(grid.size().h, reach * 2 + 1);
+  auto const col = std::min(head.x / 2 > reach ? head.x / 2 - reach : 0, grid.size().w - cols);
+  auto const row = std::min(head.y > reach ? head.y - reach : 0, grid.size().h - rows);
+  // left or below the window wraps around and is outside
+  auto const inside = [&](Pos const& pos) {return pos.x / 2 - col < cols && pos.y - row < rows;};
+  auto const idx = [&](Pos const& pos) {return (pos.y - row) * cols + pos.x / 2 - col;};
+  auto const at = [&](std::size_t const i) {return Pos((col + i % cols) * 2, row + i / cols);};
+
+  // previous cell on the shortest path
+  auto constexpr none = std::numeric_limits<std::size_t>::max();
+  auto constexpr goal = none - 1;
+  // eggs under a body are out of reach
+  auto const reachable = [&](Pos const& pos) {return inside(pos) && ! grid.test(pos);};
+  bool found {reachable(root._scene.egg->_pos)};
+  for (auto const& e : root._eggs) {found = found || reachable(e->_pos);}
+  if (! found) {return {};}
+  _prev.assign(cols * rows, none);
+  auto const target = [&](Pos const& pos) {
+    if (reachable(pos)) {_prev.at(idx(pos)) = goal;}
+  };
+  target(root._scene.egg->_pos);
+  for (auto const& e : root._eggs) {target(e->_pos);}
+
+  auto const start = idx(head);
+  _prev.at(start) = start;
+  _queue.clear();
+  _queue.emplace_back(start);
+  for (std::size_t i = 0; i < _queue.size(); ++i) {
+    auto const cur = _queue.at(i);
+    auto const pos = at(cur);
+    for (auto const& e : {Pos(pos.x - 2, pos.y), Pos(pos.x + 2, pos.y), Pos(pos.x, pos.y - 1), Pos(pos.x, pos.y + 1)}) {
+      if (! inside(e)) {continue;}
+      auto& prev = _prev.at(idx(e));
+      if (prev == goal) {
+        // walk back to the first step after the head
+        if (cur == start) {return e;}
+        auto step = cur;
+        while (_prev.at(step) != start) {step = _prev.at(step);}
+        return at(step);
+      }
+      if (prev != none || grid.test(e)) {continue;}
+      prev = cur;
+      _queue.emplace_back(idx(e));
+    }
+  }
+  return {};
+}
+
+void Bot::respawn() {
+  auto& root = *_ctx->_root;
+  for (auto const& e : _body) {
+    root._grid.reset(e);
+    _drawn.erase.emplace_back(e);
+  }
+  _body.clear();
+  _ext = 2;
+  // on a full board the next step tries again
+  if (auto const pos = root._grid.random(_ctx->_random)) {
+    _body.emplace_front(*pos);
+    root._grid.set(*pos);
+  }
+  _drawn.moved = _body.size();
 }
 
 // Prompt -----------------------------------------------------------------------
 
-Prompt::Prompt(Ctx ctx) : Scene(ctx) {
+Prompt::Prompt(Ctx ctx) : Scene(ctx, Root::Ui) {
   _pos = Pos(0, 0);
   auto const& _env = _ctx->_env;
   // _readline.hist_load("./history.txt"); // debug
@@ -1225,12 +1918,12 @@ bool Prompt::on_input(Read::Ctx const& ctx) {
         }
         _delta = 0ms;
         _state = Display;
-        std::dynamic_pointer_cast<Root>(_ctx->_root)->_focus = "snake";
+        _ctx->_root->_focus = "snake";
       }
       else {
         _delta = 0ms;
         _state = Clear;
-        std::dynamic_pointer_cast<Root>(_ctx->_root)->_focus = "snake";
+        _ctx->_root->_focus = "snake";
       }
     }
     return true;
@@ -1250,6 +1943,11 @@ bool Prompt::on_update(Tick const delta) {
   return false;
 }
 
+Tick Prompt::deadline() {
+  if (_state == Display) {return std::max(_interval - _delta, Tick(0ms));}
+  return Tick::max();
+}
+
 bool Prompt::on_render(Buffer& buf) {
   switch (_state) {
     case Clear: {
@@ -1260,29 +1958,29 @@ bool Prompt::on_render(Buffer& buf) {
       if (_readline._mode == Readline::Mode::autocomplete_init || _readline._mode == Readline::Mode::autocomplete) {
         buf.cursor(Pos(_pos.x, _pos.y + 1));
         for (std::size_t x = 0; x < _size.w; ++x) {
-          buf(Cell{this, 0, _style.text, " "});
+          buf(Span{this, _zidx, _style.text, " "});
         }
         buf.cursor(Pos(_pos.x, _pos.y + 1));
-        buf(Cell{this, 0, _style.prompt, _readline._autocomplete._lhs});
-        buf(Cell{this, 0, _style.text, _readline._autocomplete._text});
+        buf(Span{this, _zidx, _style.prompt, _readline._autocomplete._lhs});
+        buf(Span{this, _zidx, _style.text, _readline._autocomplete._text});
         buf.cursor(Pos(_pos.x + _size.w - 1, _pos.y + 1));
-        buf(Cell{this, 0, _style.prompt, _readline._autocomplete._rhs});
+        buf(Span{this, _zidx, _style.prompt, _readline._autocomplete._rhs});
         for (std::size_t i = 0; i < _readline._autocomplete._hls; ++i) {
           buf.col(Pos(_readline._autocomplete._hli + i, _pos.y + 1)).style.attr |= Style::Reverse;
         }
       }
       buf.cursor(_pos);
-      buf(Cell{this, 0, _style.prompt, _readline._prompt.lhs});
-      buf(Cell{this, 0, _style.text, _readline._input.fmt});
-      buf(Cell{this, 0, _style.prompt, _readline._prompt.rhs});
+      buf(Span{this, _zidx, _style.prompt, _readline._prompt.lhs});
+      buf(Span{this, _zidx, _style.text, _readline._input.fmt});
+      buf(Span{this, _zidx, _style.prompt, _readline._prompt.rhs});
       buf.col(Pos(_readline._input.cur + 1, _pos.y)).style.attr |= Style::Reverse;
       return true;
     }
     case Display: {
       buf.cursor(_pos);
-      buf(Cell{this, 0, _status ? _style.success : _style.error, _readline._prompt.lhs});
+      buf(Span{this, _zidx, _status ? _style.success : _style.error, _readline._prompt.lhs});
       Text::View vbuf {_buf};
-      buf(Cell{this, 0, _style.text, std::string(vbuf.colstr(0, _size.w - 1))});
+      buf(Span{this, _zidx, _style.text, std::string(vbuf.colstr(0, _size.w - 1))});
       return true;
     }
   }
@@ -1291,7 +1989,7 @@ bool Prompt::on_render(Buffer& buf) {
 
 // Status -----------------------------------------------------------------------
 
-Status::Status(Ctx ctx) : Scene(ctx) {
+Status::Status(Ctx ctx) : Scene(ctx, Root::Ui) {
 }
 
 Status::~Status() {
@@ -1306,23 +2004,31 @@ bool Status::on_input(Read::Ctx const& ctx) {
 }
 
 bool Status::on_update(Tick const delta) {
+  // fps and frames alone follow the other scenes instead of forcing a frame
+  auto const time = _text.time;
+  auto const dir = _text.dir;
   widget_fps();
   widget_dir();
-  return false;
+  return _text.time != time || _text.dir != dir;
+}
+
+Tick Status::deadline() {
+  // the next change of the elapsed seconds
+  return 1000ms - std::chrono::duration_cast<Tick>(_ctx->_time % 1000ms);
 }
 
 bool Status::on_render(Buffer& buf) {
   buf.cursor(Pos(0, 1));
   for (std::size_t x = 0; x < _size.w; ++x) {
-    buf(Cell{this, 0, _style.line, _text.line});
+    buf(Span{this, _zidx, _style.line, _text.line});
   }
   buf.cursor(Pos(0, 1));
-  buf(Cell{this, 0, _style.name, _text.name});
-  buf(Cell{this, 0, _style.val, " " + _text.fpsv});
-  buf(Cell{this, 0, _style.val, " " + std::to_string(_ctx->_fps_dropped)});
-  buf(Cell{this, 0, _style.val, " " + _text.frames});
-  buf(Cell{this, 0, _style.val, " " + _text.time});
-  buf(Cell{this, 0, _style.val, " " + _text.dir});
+  buf(Span{this, _zidx, _style.name, _text.name});
+  buf(Span{this, _zidx, _style.val, " " + _text.fpsv});
+  buf(Span{this, _zidx, _style.val, " " + std::to_string(_ctx->_fps_dropped)});
+  buf(Span{this, _zidx, _style.val, " " + _text.frames});
+  buf(Span{this, _zidx, _style.val, " " + _text.time});
+  buf(Span{this, _zidx, _style.val, " " + _text.dir});
   return false;
 }
 
@@ -1333,7 +2039,7 @@ void Status::widget_fps() {
 }
 
 void Status::widget_dir() {
-  auto& snake = *std::dynamic_pointer_cast<Snake>(std::dynamic_pointer_cast<Root>(_ctx->_root)->_scenes.at("snake"));
+  auto& snake = *_ctx->_root->_scene.snake;
   switch (snake._dir_prev) {
     case Snake::Up: {
       _text.dir = _sym.up;
@@ -1385,92 +2091,1184 @@ void Status::widget_dir() {
 
 // TODO handle out of range buffer read writes
 
-void Buffer::operator()(Cell const& cell) {
-  OB::Text::View view {cell.text};
-  for (auto const& e : view) {
-    if (e.cols == 2) {
-      if (_pos.x + 1 == _size.w - 1) {
-        _pos.x = 0;
-        if (++_pos.y >= _size.h) {
-          _pos.y = 0;
-        }
-      }
-      auto& val = _value.at(_size.h - _pos.y - 1).at(_pos.x);
-      if (cell.zidx >= val.zidx) {
-        val = Cell{cell.scene, cell.zidx, cell.style, std::string{e.str}};
-      }
-      if (++_pos.x >= _size.w) {
-        _pos.x = 0;
-        if (++_pos.y >= _size.h) {
-          _pos.y = 0;
-        }
+void Buffer::operator()(Span const& span) {
+  _view.str(span.text);
+  for (auto const& e : _view) {
+    if (e.cols == 2 && _pos.x + 1 >= _size.w) {
+      _pos.x = 0;
+      if (++_pos.y >= _size.h) {
+        _pos.y = 0;
       }
     }
-    else {
-      auto& val = _value.at(_size.h - _pos.y - 1).at(_pos.x);
-      if (cell.zidx >= val.zidx) {
-        val = Cell{cell.scene, cell.zidx, cell.style, std::string{e.str}};
-      }
-      if (++_pos.x >= _size.w) {
-        _pos.x = 0;
-        if (++_pos.y >= _size.h) {
-          _pos.y = 0;
-        }
-      }
+    (*this)(Cell{span.scene, span.zidx, span.style, Glyph(e.str, e.cols)});
+    if (e.cols == 2) {
+      // the empty glyph marks the column covered by the wide glyph before it
+      (*this)(Cell{span.scene, span.zidx, span.style, Glyph()});
     }
   }
 }
 
-Cell& Buffer::at(Pos const& pos) {
-  return _value.at(pos.y).at(pos.x);
+void Buffer::operator()(Cell const& cell) {
+  auto const y = _size.h - _pos.y - 1;
+  auto& val = _value.at(y * _size.w + _pos.x);
+  if (cell.zidx >= val.zidx) {
+    val = cell;
+  }
+  // covered writes count too, the compositor redraws the layer when the cover goes away
+  damage(_pos.x, y);
+  advance();
 }
 
-std::vector<Cell>& Buffer::row(std::size_t y) {
-  return _value.at(_size.h - y - 1);
+void Buffer::advance() {
+  if (++_pos.x >= _size.w) {
+    _pos.x = 0;
+    if (++_pos.y >= _size.h) {
+      _pos.y = 0;
+    }
+  }
 }
 
-Cell& Buffer::col(Pos const& pos) {
-  return _value.at(_size.h - pos.y - 1).at(pos.x);
+void Buffer::copy(Buffer const& buf) {
+  _pos = buf._pos;
+  if (_value.size() == buf._value.size()) {
+    std::memcpy(_value.data(), buf._value.data(), _value.size() * sizeof(Cell));
+  }
+  else {
+    _value = buf._value;
+  }
+  _size = buf._size;
 }
 
-Size Buffer::size() {
-  return _size;
+Cell& Buffer::at(Pos const& pos) {
+  return _value.at(pos.y * _size.w + pos.x);
 }
 
-Pos Buffer::cursor() {
-  return _pos;
+Cell* Buffer::row(std::size_t y) {
+  return &_value.at((_size.h - y - 1) * _size.w);
 }
 
-void Buffer::cursor(Pos const& pos) {
+Cell& Buffer::col(Pos const& pos) {
+  auto const y = _size.h - pos.y - 1;
+  auto& cell = _value.at(y * _size.w + pos.x);
+  damage(pos.x, y);
+  return cell;
+}
+
+Cell* Buffer::col(Pos const& pos, int const zidx) {
+  auto const y = _size.h - pos.y - 1;
+  auto& cell = _value.at(y * _size.w + pos.x);
+  damage(pos.x, y);
+  if (cell.zidx > zidx) {return nullptr;}
+  // the caller writes to it, lower layers must not touch it again
+  cell.zidx = zidx;
+  return &cell;
+}
+
+std::vector<Rect>& Buffer::damage() {
+  return _damage;
+}
+
+void Buffer::damage(Rect const& rect) {
+  _damage.emplace_back(rect);
+}
+
+void Buffer::damage(std::size_t const x, std::size_t const y) {
+  // extend the last region when writes continue along the same row
+  if (_damage.size()) {
+    auto& rect = _damage.back();
+    if (rect.pos.y == y && rect.size.h == 1 && rect.pos.x + rect.size.w == x) {
+      ++rect.size.w;
+      return;
+    }
+  }
+  _damage.emplace_back(Pos(x, y), Size(1, 1));
+}
+
+Size Buffer::size() {
+  return _size;
+}
+
+Pos Buffer::cursor() {
+  return _pos;
+}
+
+void Buffer::cursor(Pos const& pos) {
   _pos = pos;
 }
 
-void Buffer::size(Size const& size) {
-  _size = size;
-  _pos = Pos();
-  _value.clear();
-  for (std::size_t h = 0; h < _size.h; ++h) {
-    _value.emplace_back();
-    for (std::size_t w = 0; w < _size.w; ++w) {
-      _value.back().emplace_back();
-    }
-  }
+void Buffer::size(Size const& size) {
+  _size = size;
+  _pos = Pos();
+  _value.assign(_size.w * _size.h, Cell());
+}
+
+bool Buffer::empty() {
+  return _value.empty();
+}
+
+void Buffer::clear() {
+  _pos = Pos();
+  _size = Size();
+  _value.clear();
+  _damage.clear();
+}
+
+// Encoder -----------------------------------------------------------------------
+
+void Encoder::size(Size const& size) {
+  _size = size;
+  reset();
+}
+
+void Encoder::reset() {
+  _pos_valid = false;
+  _style_valid = false;
+}
+
+void Encoder::redraw() {
+  _value += aec::clear;
+  _value += aec::screen_clear;
+  _value += aec::cursor_home;
+  _pos = Pos();
+  _pos_valid = true;
+  _style_valid = false;
+}
+
+void Encoder::num(std::string& str, std::size_t const val) {
+  char buf[20];
+  std::size_t i {sizeof(buf)};
+  std::size_t n {val};
+  do {
+    buf[--i] = static_cast<char>('0' + (n % 10));
+    n /= 10;
+  }
+  while (n);
+  str.append(&buf[i], sizeof(buf) - i);
+}
+
+void Encoder::num(std::size_t const val) {
+  num(_value, val);
+}
+
+std::size_t Encoder::num_size(std::size_t const val) {
+  std::size_t size {1};
+  for (std::size_t n = val / 10; n; n /= 10) {++size;}
+  return size;
+}
+
+// size of 'CSI n ch', where 'n' is omitted when it's 1
+std::size_t Encoder::csi_size(std::size_t const val) {
+  return 3 + (val > 1 ? num_size(val) : 0);
+}
+
+void Encoder::csi(std::size_t const val, char const ch) {
+  _value += "\x1b[";
+  if (val > 1) {num(val);}
+  _value += ch;
+}
+
+// cheapest horizontal move on the current row
+std::size_t Encoder::col_size(std::size_t const from, std::size_t const to) {
+  if (to == from) {return 0;}
+  if (to == 0) {return 1;}
+  if (to > from) {return csi_size(to - from);}
+  return std::min(csi_size(from - to), 1 + csi_size(to));
+}
+
+void Encoder::col(std::size_t const from, std::size_t const to) {
+  if (to == from) {return;}
+  if (to == 0) {
+    _value += '\r';
+  }
+  else if (to > from) {
+    csi(to - from, 'C');
+  }
+  else if (csi_size(from - to) <= 1 + csi_size(to)) {
+    csi(from - to, 'D');
+  }
+  else {
+    _value += '\r';
+    csi(to, 'C');
+  }
+}
+
+void Encoder::cursor(Pos const& pos) {
+  // absolute 'CSI y ; x H', with defaulted parameters omitted
+  std::size_t const abs_size {3 + (pos.y ? num_size(pos.y + 1) : 0) + (pos.x ? 1 + num_size(pos.x + 1) : 0)};
+
+  if (! _pos_valid) {
+    _value += "\x1b[";
+    if (pos.y) {num(pos.y + 1);}
+    if (pos.x) {_value += ';'; num(pos.x + 1);}
+    _value += 'H';
+    _pos = pos;
+    _pos_valid = true;
+    return;
+  }
+
+  if (pos.y == _pos.y && pos.x == _pos.x) {return;}
+
+  enum {Abs, Rel, Crlf} mode {Abs};
+  std::size_t size {abs_size};
+
+  // relative 'CUU' or 'CUD' followed by a horizontal move
+  std::size_t const rel_size {(pos.y == _pos.y ? 0 : csi_size(pos.y > _pos.y ? pos.y - _pos.y : _pos.y - pos.y)) + col_size(_pos.x, pos.x)};
+  if (rel_size < size) {
+    mode = Rel;
+    size = rel_size;
+  }
+
+  // carriage return and line feed to the start of the next row
+  if (pos.y == _pos.y + 1) {
+    std::size_t const crlf_size {2 + (pos.x ? csi_size(pos.x) : 0)};
+    if (crlf_size < size) {
+      mode = Crlf;
+      size = crlf_size;
+    }
+  }
+
+  switch (mode) {
+    case Abs: {
+      _value += "\x1b[";
+      if (pos.y) {num(pos.y + 1);}
+      if (pos.x) {_value += ';'; num(pos.x + 1);}
+      _value += 'H';
+      break;
+    }
+    case Rel: {
+      if (pos.y > _pos.y) {csi(pos.y - _pos.y, 'B');}
+      else if (pos.y < _pos.y) {csi(_pos.y - pos.y, 'A');}
+      col(_pos.x, pos.x);
+      break;
+    }
+    case Crlf: {
+      _value += "\r\n";
+      if (pos.x) {csi(pos.x, 'C');}
+      break;
+    }
+  }
+
+  _pos = pos;
+}
+
+void Encoder::depth(std::uint8_t const type) {
+  if (type == _depth) {return;}
+  _depth = type;
+  _style_valid = false;
+  _sgr.clear();
+}
+
+std::uint8_t Encoder::depth() {
+  return _depth;
+}
+
+// nearest colour of the 6x6x6 cube or the grey ramp, skipping the themed first 16
+std::uint8_t Encoder::xterm_256(Color const& color) {
+  static constexpr std::array<int, 6> level {0, 95, 135, 175, 215, 255};
+  // per channel nearest cube level, and nearest grey ramp step
+  static auto const table = []() {
+    std::array<std::array<std::uint8_t, 256>, 2> res;
+    for (std::size_t v = 0; v < 256; ++v) {
+      std::size_t idx {0};
+      for (std::size_t i = 1; i < level.size(); ++i) {
+        if (std::abs(level.at(i) - static_cast<int>(v)) < std::abs(level.at(idx) - static_cast<int>(v))) {idx = i;}
+      }
+      res.at(0).at(v) = static_cast<std::uint8_t>(idx);
+      res.at(1).at(v) = static_cast<std::uint8_t>(std::min<std::size_t>(v < 3 ? 0 : (v - 3) / 10, 23));
+    }
+    return res;
+  }();
+
+  auto const dist = [&](int const r, int const g, int const b) {
+    return (r - color.r) * (r - color.r) + (g - color.g) * (g - color.g) + (b - color.b) * (b - color.b);
+  };
+
+  auto const r = table[0][color.r];
+  auto const g = table[0][color.g];
+  auto const b = table[0][color.b];
+  auto const grey = table[1][(std::size_t {color.r} + color.g + color.b) / 3];
+  auto const grey_level = 8 + 10 * grey;
+
+  if (dist(grey_level, grey_level, grey_level) < dist(level[r], level[g], level[b])) {
+    return static_cast<std::uint8_t>(232 + grey);
+  }
+  return static_cast<std::uint8_t>(16 + 36 * r + 6 * g + b);
+}
+
+// nearest colour of the default xterm 16 colour palette
+std::uint8_t Encoder::xterm_16(Color const& color) {
+  // indexed by the high 4 bits of each channel
+  static auto const table = []() {
+    std::array<std::array<int, 3>, 16> const palette {{
+      {0, 0, 0}, {205, 0, 0}, {0, 205, 0}, {205, 205, 0},
+      {0, 0, 238}, {205, 0, 205}, {0, 205, 205}, {229, 229, 229},
+      {127, 127, 127}, {255, 0, 0}, {0, 255, 0}, {255, 255, 0},
+      {92, 92, 255}, {255, 0, 255}, {0, 255, 255}, {255, 255, 255},
+    }};
+    std::array<std::uint8_t, 4096> res;
+    for (std::size_t i = 0; i < res.size(); ++i) {
+      std::array<int, 3> const rgb {
+        static_cast<int>((i >> 8) & 15) * 17,
+        static_cast<int>((i >> 4) & 15) * 17,
+        static_cast<int>(i & 15) * 17,
+      };
+      std::size_t idx {0};
+      int min {std::numeric_limits<int>::max()};
+      for (std::size_t j = 0; j < palette.size(); ++j) {
+        int dist {0};
+        for (std::size_t k = 0; k < 3; ++k) {
+          dist += (palette[j][k] - rgb[k]) * (palette[j][k] - rgb[k]);
+        }
+        if (dist < min) {
+          min = dist;
+          idx = j;
+        }
+      }
+      res[i] = static_cast<std::uint8_t>(idx);
+    }
+    return res;
+  }();
+
+  return table[static_cast<std::size_t>(((color.r >> 4) << 8) | ((color.g >> 4) << 4) | (color.b >> 4))];
+}
+
+// quantize a style to the output colour depth
+Style Encoder::convert(Style const& style) {
+  if (style.type <= _depth) {return style;}
+  Style res {_depth, style.attr, Color(), Color()};
+  switch (_depth) {
+    case Style::Bit_8: {
+      res.fg.r = xterm_256(style.fg);
+      res.bg.r = xterm_256(style.bg);
+      break;
+    }
+    case Style::Bit_4: {
+      res.fg.r = xterm_16(style.fg);
+      res.bg.r = xterm_16(style.bg);
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+  return res;
+}
+
+std::uint64_t Encoder::sgr_key(Sgr const type, Style const& style) {
+  switch (type) {
+    case Sgr::Fg: {
+      return (1ull << 62) | (static_cast<std::uint64_t>(style.type) << 24) | (static_cast<std::uint64_t>(style.fg.r) << 16) | (static_cast<std::uint64_t>(style.fg.g) << 8) | style.fg.b;
+    }
+    case Sgr::Bg: {
+      return (1ull << 63) | (static_cast<std::uint64_t>(style.type) << 24) | (static_cast<std::uint64_t>(style.bg.r) << 16) | (static_cast<std::uint64_t>(style.bg.g) << 8) | style.bg.b;
+    }
+    default: {
+      return (static_cast<std::uint64_t>(style.type) << 56) | (static_cast<std::uint64_t>(style.attr) << 48) |
+        (static_cast<std::uint64_t>(style.fg.r) << 40) | (static_cast<std::uint64_t>(style.fg.g) << 32) | (static_cast<std::uint64_t>(style.fg.b) << 24) |
+        (static_cast<std::uint64_t>(style.bg.r) << 16) | (static_cast<std::uint64_t>(style.bg.g) << 8) | style.bg.b;
+    }
+  }
+}
+
+// size of the legacy 'CSI 38;2;r;g;b m' colour sequence
+std::size_t Encoder::sgr_size(Color const& color) {
+  return 10 + num_size(color.r) + num_size(color.g) + num_size(color.b);
+}
+
+void Encoder::sgr_color(std::string& str, bool const bg, std::uint8_t const type, Color const& color) {
+  switch (type) {
+    case Style::Bit_24: {
+      str += bg ? "48;2;" : "38;2;";
+      num(str, color.r);
+      str += ';';
+      num(str, color.g);
+      str += ';';
+      num(str, color.b);
+      break;
+    }
+    case Style::Bit_8: {
+      str += bg ? "48;5;" : "38;5;";
+      num(str, color.r);
+      break;
+    }
+    case Style::Bit_4: {
+      // 30-37 and 90-97, 40-47 and 100-107 for the bright half
+      num(str, (color.r < 8 ? (bg ? 40u : 30u) : (bg ? 92u : 82u)) + color.r);
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
+
+std::string const& Encoder::sgr(Sgr const type, Style const& style) {
+  auto const key = sgr_key(type, style);
+  if (auto const it = _sgr.find(key); it != _sgr.end()) {
+    ++_stats.sgr_hit;
+    return it->second;
+  }
+
+  ++_stats.sgr_miss;
+  if (_sgr.size() >= _sgr_max) {
+    // bound the cache when animations cycle through many colours
+    _sgr.clear();
+  }
+
+  std::string str {"\x1b["};
+  switch (type) {
+    case Sgr::Fg: {
+      sgr_color(str, false, style.type, style.fg);
+      break;
+    }
+    case Sgr::Bg: {
+      sgr_color(str, true, style.type, style.bg);
+      break;
+    }
+    default: {
+      str += '0';
+      if (style.attr & Style::Bold) {str += ";1";}
+      if (style.attr & Style::Reverse) {str += ";7";}
+      if (style.type != Style::Bit_2) {
+        str += ';';
+        sgr_color(str, false, style.type, style.fg);
+        str += ';';
+        sgr_color(str, true, style.type, style.bg);
+      }
+      break;
+    }
+  }
+  str += 'm';
+
+  return _sgr.emplace(key, std::move(str)).first->second;
+}
+
+// attribute transitions that leave the current colours untouched
+std::string const& Encoder::sgr_attr(std::uint8_t const from, std::uint8_t const to) {
+  static auto const table = []() {
+    std::array<std::string, 16> res;
+    for (std::size_t lhs = 0; lhs < 4; ++lhs) {
+      for (std::size_t rhs = 0; rhs < 4; ++rhs) {
+        std::string str;
+        auto const set = [&](std::size_t const attr, char const* on, char const* off) {
+          if ((lhs & attr) == (rhs & attr)) {return;}
+          str += str.empty() ? "\x1b[" : ";";
+          str += (rhs & attr) ? on : off;
+        };
+        set(Style::Bold, "1", "22");
+        set(Style::Reverse, "7", "27");
+        if (! str.empty()) {str += 'm';}
+        res.at((lhs << 2) | rhs) = str;
+      }
+    }
+    return res;
+  }();
+  // a fixed table, not counted against the sgr cache
+  return table.at(static_cast<std::size_t>(((from & 3) << 2) | (to & 3)));
+}
+
+void Encoder::style(Style const& style) {
+  if (_style_valid && _style_in == style) {return;}
+  _style_in = style;
+  auto const out = convert(style);
+  if (_style_valid && _style == out) {return;}
+
+  // legacy size is measured against the requested style
+  auto const begin = _value.size();
+  std::size_t legacy {0};
+  auto const attr_size = [](std::uint8_t const attr) {
+    return aec::clear.size() + ((attr & Style::Bold) ? aec::bold.size() : 0) + ((attr & Style::Reverse) ? aec::reverse.size() : 0);
+  };
+
+  if (! _style_valid || _style.type != out.type) {
+    // unknown terminal state, emit the complete style as one sequence
+    _value += sgr(Sgr::Full, out);
+    legacy = attr_size(style.attr);
+    if (style.type == Style::Bit_24) {legacy += sgr_size(style.fg) + sgr_size(style.bg);}
+  }
+  else {
+    bool const diff_fg {_style.fg.r != out.fg.r || _style.fg.g != out.fg.g || _style.fg.b != out.fg.b};
+    bool const diff_bg {_style.bg.r != out.bg.r || _style.bg.g != out.bg.g || _style.bg.b != out.bg.b};
+
+    if (_style.attr != out.attr) {
+      _value += sgr_attr(_style.attr, out.attr);
+      legacy = attr_size(style.attr);
+      if (style.type == Style::Bit_24) {legacy += sgr_size(style.fg) + sgr_size(style.bg);}
+    }
+    else if (style.type == Style::Bit_24) {
+      if (diff_fg) {legacy += sgr_size(style.fg);}
+      if (diff_bg) {legacy += sgr_size(style.bg);}
+    }
+
+    if (out.type != Style::Bit_2) {
+      if (diff_fg) {_value += sgr(Sgr::Fg, out);}
+      if (diff_bg) {_value += sgr(Sgr::Bg, out);}
+    }
+  }
+
+  _style = out;
+  _style_valid = true;
+
+  auto const size = _value.size() - begin;
+  if (legacy > size) {_stats.sgr_saved += legacy - size;}
+}
+
+void Encoder::text(std::string_view const str, std::size_t const cols) {
+  _value += str;
+  _pos.x += cols;
+  // the cursor is left in a pending wrap state on the last column
+  if (_pos.x >= _size.w) {_pos_valid = false;}
+}
+
+std::string& Encoder::str() {
+  return _value;
+}
+
+Encoder::Stats& Encoder::stats() {
+  return _stats;
+}
+
+bool Encoder::empty() {
+  return _value.empty();
+}
+
+void Encoder::clear() {
+  _value.clear();
+}
+
+// Perf ---------------------------------------------------------------------------
+
+Perf::Perf(Ctx ctx) : Scene(ctx, Root::Overlay) {
+  auto const& _env = _ctx->_env;
+
+  (*_env)["perf-overlay"] = Val{Fun{str_lst("(a)"), [&](auto e) -> Xpr {
+    auto x = eval(sym_xpr("a"), e);
+    if (auto const v = xpr_int(&x)) {
+      _enabled = *v != 0;
+      _delta = 0ms;
+      if (_enabled) {refresh();}
+      return x;
+    }
+    throw std::runtime_error("expected 'Int'");
+  }}, _env, Val::evaled};
+}
+
+Perf::~Perf() {
+}
+
+void Perf::on_winch(Size const& size) {
+  _size = size;
+}
+
+bool Perf::on_input(Read::Ctx const& ctx) {
+  return false;
+}
+
+bool Perf::on_update(Tick const delta) {
+  if (! _enabled) {return false;}
+  _delta += delta;
+  if (_delta >= _interval) {
+    _delta = 0ms;
+    refresh();
+    return true;
+  }
+  return false;
+}
+
+Tick Perf::deadline() {
+  if (! _enabled) {return Tick::max();}
+  return std::max(_interval - _delta, Tick(0ms));
+}
+
+bool Perf::on_render(Buffer& buf) {
+  if (! _enabled || _size.w < _width || _size.h < _lines.size() + 3) {return false;}
+  // top right corner, below nothing else
+  std::size_t y {_size.h - 1};
+  for (std::size_t i = 0; i < _lines.size(); ++i, --y) {
+    buf.cursor(Pos(_size.w - _width, y));
+    buf(Span{this, _zidx, i ? _style.text : _style.name, _lines.at(i)});
+  }
+  buf.cursor(Pos(_size.w - _width, y));
+  buf(Span{this, _zidx, _style.graph, _graph});
+  return true;
+}
+
+void Perf::refresh() {
+  auto const& perf = _ctx->_perf;
+  auto const& out = _ctx->_out.stats();
+  char str[64];
+
+  _lines.clear();
+  std::snprintf(&str[0], sizeof(str), " %-*s%10s%10s%10s ", static_cast<int>(_width - 32), "us", "p50", "p99", "max");
+  _lines.emplace_back(str);
+  auto const row = [&](char const* name, Histogram const& hist) {
+    auto const us = [](Tick const val) {return static_cast<double>(val.count()) / 1000.0;};
+    std::snprintf(&str[0], sizeof(str), " %-*s%10.1f%10.1f%10.1f ", static_cast<int>(_width - 32), name,
+      us(hist.percentile(0.5)), us(hist.percentile(0.99)), us(hist.max()));
+    _lines.emplace_back(str);
+  };
+  row("tick", perf.tick);
+  row("input", perf.input);
+  row("update", perf.update);
+  row("render", perf.render);
+  row("diff", out.diff);
+  row("encode", out.encode);
+  row("write", out.write);
+  row("latency", _ctx->_sched.latency);
+  row("jitter", _ctx->_sched.jitter);
+
+  // recent tick times scaled to the slowest one
+  static std::array<char const*, 8> const level {"▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+  auto const size = std::min(perf.recent.size(), _width - 2);
+  Tick max {1};
+  for (std::size_t i = 0; i < size; ++i) {
+    max = std::max(max, perf.recent.at((perf.idx + perf.recent.size() - size + i) % perf.recent.size()));
+  }
+  _graph = " ";
+  for (std::size_t i = 0; i < size; ++i) {
+    auto const val = perf.recent.at((perf.idx + perf.recent.size() - size + i) % perf.recent.size());
+    _graph += level.at(static_cast<std::size_t>(val.count() * 7 / max.count()));
+  }
+  _graph += std::string(_width - 1 - size, ' ');
+}
+
+// Histogram ---------------------------------------------------------------------
+
+void Histogram::add(Tick const val) {
+  auto const ns = static_cast<std::uint64_t>(std::max(val.count(), Tick::rep(0)));
+  _bucket[index(ns)].fetch_add(1, std::memory_order_relaxed);
+  _count.fetch_add(1, std::memory_order_relaxed);
+  _total.fetch_add(ns, std::memory_order_relaxed);
+  auto max = _max.load(std::memory_order_relaxed);
+  while (ns > max && ! _max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+}
+
+void Histogram::clear() {
+  for (auto& e : _bucket) {e = 0;}
+  _count = 0;
+  _total = 0;
+  _max = 0;
+}
+
+std::size_t Histogram::count() const {
+  return _count;
+}
+
+Tick Histogram::total() const {
+  return Tick(_total.load());
+}
+
+Tick Histogram::mean() const {
+  auto const count = _count.load();
+  if (count == 0) {return 0ms;}
+  return Tick(_total.load() / count);
+}
+
+Tick Histogram::max() const {
+  return Tick(_max.load());
+}
+
+Tick Histogram::percentile(double const val) const {
+  auto const count = _count.load();
+  if (count == 0) {return 0ms;}
+  auto const rank = std::max(static_cast<std::size_t>(std::ceil(std::clamp(val, 0.0, 1.0) * static_cast<double>(count))), std::size_t(1));
+  std::size_t sum {0};
+  for (std::size_t i = 0; i < _size; ++i) {
+    sum += _bucket[i].load(std::memory_order_relaxed);
+    if (sum >= rank) {
+      return Tick(std::min(upper(i), _max.load()));
+    }
+  }
+  return max();
+}
+
+std::size_t Histogram::index(std::uint64_t const val) {
+  if (val < _sub) {return static_cast<std::size_t>(val);}
+  // position of the highest set bit, then the next two bits pick the sub bucket
+  auto const bit = static_cast<std::size_t>(63 - __builtin_clzll(val));
+  auto const idx = (bit - 1) * _sub + static_cast<std::size_t>((val >> (bit - 2)) & (_sub - 1));
+  return std::min(idx, _size - 1);
+}
+
+std::uint64_t Histogram::upper(std::size_t const idx) {
+  if (idx < _sub) {return idx;}
+  auto const bit = idx / _sub + 1;
+  auto const lower = static_cast<std::uint64_t>(_sub + idx % _sub) << (bit - 2);
+  return lower + (std::uint64_t(1) << (bit - 2)) - 1;
+}
+
+// Random ------------------------------------------------------------------------
+
+void Random::seed(std::uint64_t const seed) {
+  _seed = seed;
+  auto x = seed;
+  for (auto& e : _state) {
+    x += 0x9e3779b97f4a7c15;
+    auto z = x;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    e = z ^ (z >> 31);
+  }
+}
+
+std::uint64_t Random::seed() const {
+  return _seed;
+}
+
+std::uint64_t Random::next() {
+  auto const rotl = [](std::uint64_t const x, int const k) {
+    return (x << k) | (x >> (64 - k));
+  };
+  auto const res = rotl(_state[1] * 5, 7) * 9;
+  auto const t = _state[1] << 17;
+  _state[2] ^= _state[0];
+  _state[3] ^= _state[1];
+  _state[1] ^= _state[2];
+  _state[0] ^= _state[3];
+  _state[2] ^= t;
+  _state[3] = rotl(_state[3], 45);
+  return res;
+}
+
+std::size_t Random::range(std::size_t const l, std::size_t const u) {
+  std::uint64_t const span = u - l;
+  // draws past the smallest mask covering the span are thrown away, at worst half of them
+  auto mask = span;
+  for (int i = 1; i < 64; i *= 2) {mask |= mask >> i;}
+  std::uint64_t res;
+  do {res = next() & mask;} while (res > span);
+  return l + res;
+}
+
+// Grid --------------------------------------------------------------------------
+
+void Grid::size(Size const& size) {
+  _size = size;
+  for (auto& [k, v] : _chunk) {
+    v->cell.fill(0);
+    v->count = 0;
+    give(std::move(v));
+  }
+  _chunk.clear();
+  _count = 0;
+}
+
+Size Grid::size() const {
+  return _size;
+}
+
+bool Grid::inside(Pos const& pos) const {
+  return pos.x / 2 < _size.w && pos.y < _size.h;
+}
+
+bool Grid::test(Pos const& pos) const {
+  if (! inside(pos)) {return false;}
+  auto const val = find(pos);
+  return val && val->cell[slot(pos)];
+}
+
+void Grid::set(Pos const& pos) {
+  if (! inside(pos)) {return;}
+  auto& val = _chunk[key(pos)];
+  if (! val) {val = take();}
+  if (val->cell[slot(pos)]++) {return;}
+  ++val->count;
+  ++_count;
+}
+
+void Grid::reset(Pos const& pos) {
+  if (! inside(pos)) {return;}
+  auto const it = _chunk.find(key(pos));
+  if (it == _chunk.end()) {return;}
+  auto& cell = it->second->cell[slot(pos)];
+  if (! cell || --cell) {return;}
+  --_count;
+  if (! --it->second->count) {
+    give(std::move(it->second));
+    _chunk.erase(it);
+  }
+}
+
+std::size_t Grid::count() const {
+  return _count;
+}
+
+bool Grid::full() const {
+  return _count == _size.w * _size.h;
+}
+
+std::optional<Pos> Grid::random(Random& rng) const {
+  if (full()) {return {};}
+  auto const draw = [&] {
+    return Pos(rng.range(0, _size.w - 1) * 2, rng.range(0, _size.h - 1));
+  };
+  // a mostly empty board finds a cell within a few draws
+  for (int i = 0; i < 32; ++i) {
+    auto const pos = draw();
+    if (! test(pos)) {return pos;}
+  }
+  // count down to the nth empty cell through the allocated chunks,
+  // the cells of every unallocated chunk count as one last group
+  auto n = rng.range(0, _size.w * _size.h - _count - 1);
+  for (auto const& [k, v] : _chunk) {
+    auto const col = (k & 0xffffffff) * chunk_size;
+    auto const row = (k >> 32) * chunk_size;
+    auto const w = std::min(chunk_size, _size.w - col);
+    auto const h = std::min(chunk_size, _size.h - row);
+    auto const empty = w * h - v->count;
+    if (n >= empty) {
+      n -= empty;
+      continue;
+    }
+    for (std::size_t y = 0; y < h; ++y) {
+      for (std::size_t x = 0; x < w; ++x) {
+        if (v->cell[y * chunk_size + x]) {continue;}
+        if (! n--) {return Pos((col + x) * 2, row + y);}
+      }
+    }
+  }
+  // every cell of an unallocated chunk is empty, draws landing in one are uniform over them
+  while (true) {
+    auto const pos = draw();
+    if (! find(pos)) {return pos;}
+  }
+}
+
+std::size_t Grid::chunks() const {
+  return _chunk.size();
+}
+
+std::uint64_t Grid::key(Pos const& pos) const {
+  return (static_cast<std::uint64_t>(pos.y / chunk_size) << 32) | ((pos.x / 2) / chunk_size);
+}
+
+std::size_t Grid::slot(Pos const& pos) const {
+  return (pos.y % chunk_size) * chunk_size + (pos.x / 2) % chunk_size;
+}
+
+Grid::Chunk* Grid::find(Pos const& pos) const {
+  auto const it = _chunk.find(key(pos));
+  return it == _chunk.end() ? nullptr : it->second.get();
+}
+
+std::unique_ptr<Grid::Chunk> Grid::take() {
+  if (_spare.empty()) {return std::make_unique<Chunk>();}
+  auto val = std::move(_spare.back());
+  _spare.pop_back();
+  return val;
+}
+
+void Grid::give(std::unique_ptr<Chunk>&& val) {
+  // chunks come back empty, a few are kept so memory follows the covered area
+  if (_spare.size() < 16) {_spare.emplace_back(std::move(val));}
+  val.reset();
+}
+
+// Output ------------------------------------------------------------------------
+
+Output::Output() {
+  _enc.str().reserve(1000000);
+}
+
+Output::~Output() {
+  // the stream would close the descriptor on its own
+  if (_stream) {_stream->release();}
+  if (_fd >= 0 && _fd != STDOUT_FILENO) {::close(_fd);}
+}
+
+void Output::size(Size const& size) {
+  _size = size;
+  _enc.size(_size);
+  _dirty.clear();
+  _dirty.reserve(_size.w * _size.h);
+}
+
+void Output::frame(Buffer& buf, Buffer& prev, Spans const& span) {
+  // read once, '(sync)' can change it between the begin and end markers
+  bool const sync {_sync};
+  _timer.clear();
+  _timer.start();
+  std::size_t area {0};
+  for (std::size_t y = 0; y < _size.h; ++y) {
+    auto const x_begin = span.at(y).first;
+    auto const x_end = span.at(y).second;
+    if (x_begin >= x_end) {continue;}
+    area += x_end - x_begin;
+    for (std::size_t x = x_begin; x < x_end; ++x) {
+      auto const& cell = buf.at(Pos(x, y));
+      auto& cell_prev = prev.at(Pos(x, y));
+      if (cell.text != cell_prev.text || cell.style != cell_prev.style) {
+        if (cell.text == Glyph() && x && (_dirty.empty() || _dirty.back().x != x - 1 || _dirty.back().y != y)) {
+          // redraw the wide glyph covering this column
+          _dirty.emplace_back(x - 1, y);
+        }
+        _dirty.emplace_back(x, y);
+        cell_prev = cell;
+      }
+    }
+  }
+
+  _timer.stop();
+  _stats.diff.add(_timer.time<Tick>());
+  _timer.clear();
+  _timer.start();
+
+  // cells already on screen keep the old depth until they are redrawn
+  bool const depth {_enc.depth() != _depth};
+  if (depth) {_enc.depth(_depth);}
+
+  auto& str = _enc.str();
+  if (sync) {str += "\x1b[?2026h";}
+  auto const begin = str.size();
+
+  if (depth || static_cast<double>(_dirty.size()) > _redraw_ratio * static_cast<double>(_size.w * _size.h)) {
+    // most of the screen changed, redraw every cell in order
+    _enc.redraw();
+    for (std::size_t y = 0; y < _size.h; ++y) {
+      for (std::size_t x = 0; x < _size.w; ++x) {
+        auto const& cell = buf.at(Pos(x, y));
+        if (cell.text == Glyph()) {continue;}
+        _enc.cursor(Pos(x, y));
+        _enc.style(cell.style);
+        _enc.text(cell.text.str(), cell.text.cols());
+      }
+    }
+  }
+  else {
+    for (auto const& pos : _dirty) {
+      auto const& cell = buf.at(pos);
+      if (cell.text == Glyph()) {continue;}
+      _enc.cursor(pos);
+      _enc.style(cell.style);
+      _enc.text(cell.text.str(), cell.text.cols());
+    }
+  }
+  _dirty.clear();
+
+  if (str.size() == begin) {
+    // nothing changed
+    str.clear();
+  }
+  else if (sync) {
+    // the terminal presents the frame at once when it sees the end marker
+    str += "\x1b[?2026l";
+  }
+
+  _timer.stop();
+  _stats.encode.add(_timer.time<Tick>());
+  _timer.clear();
+  _timer.start();
+
+  // flush the whole frame with one write
+  auto const bytes = str.size();
+  auto const syscalls = write(! _stream);
+
+  _timer.stop();
+  _stats.write.add(_timer.time<Tick>());
+
+  auto const& stats = _enc.stats();
+  _stats.sgr_hit = stats.sgr_hit;
+  _stats.sgr_miss = stats.sgr_miss;
+  _stats.sgr_saved = stats.sgr_saved;
+  _stats.area = area;
+  _stats.bytes += bytes;
+  _stats.syscalls += syscalls;
+  if (bytes) {
+    _stats.frame_bytes = bytes;
+    _stats.frame_syscalls = syscalls;
+  }
+  ++_stats.frames;
+}
+
+Output::Stats& Output::stats() {
+  return _stats;
+}
+
+void Output::sync(bool const val) {
+  _sync = val;
+}
+
+bool Output::sync() {
+  return _sync;
+}
+
+void Output::depth(std::uint8_t const type) {
+  _depth = type;
+}
+
+std::uint8_t Output::depth() {
+  return _depth;
 }
 
-bool Buffer::empty() {
-  return _value.empty();
+void Output::sink(int const fd) {
+  if (_fd >= 0 && _fd != STDOUT_FILENO && _fd != fd) {::close(_fd);}
+  _fd = fd;
 }
 
-void Buffer::clear() {
-  _pos = Pos();
-  _size = Size();
-  _value.clear();
+void Output::async(Belle::asio::io_context& io, std::function<void()> on_flush) {
+  if (_fd < 0) {return;}
+  _stream.emplace(io, _fd);
+  _on_flush = on_flush;
+}
+
+bool Output::busy() {
+  return ! _enc.empty();
+}
+
+void Output::flush() {
+  _stats.syscalls += write(true);
+}
+
+std::size_t Output::write(bool const wait) {
+  auto& line = _enc.str();
+  if (line.empty()) {return 0;}
+  if (_fd < 0) {
+    line.clear();
+    return 0;
+  }
+  std::size_t calls {0};
+  while (_offset < line.size()) {
+    ++calls;
+    auto const num = ::write(_fd, line.data() + _offset, line.size() - _offset);
+    if (num < 0) {
+      if (errno == EINTR) {continue;}
+#if EAGAIN != EWOULDBLOCK
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+#else
+      if (errno == EAGAIN) {
+#endif
+        ++_stats.full;
+        if (! wait) {
+          // keep the rest until the terminal drains, later frames are merged meanwhile
+          await_write();
+          return calls;
+        }
+        // wait for the terminal to drain instead of spinning
+        pollfd pfd {_fd, POLLOUT, 0};
+        while (::poll(&pfd, 1, -1) < 0 && errno == EINTR) {}
+        continue;
+      }
+      throw std::runtime_error("write failed");
+    }
+    _offset += static_cast<std::size_t>(num);
+  }
+  line.clear();
+  _offset = 0;
+  return calls;
+}
+
+void Output::await_write() {
+  if (_waiting) {return;}
+  _waiting = true;
+  _stream->async_wait(Belle::asio::posix::stream_descriptor::wait_write, [&](auto ec) {
+    _waiting = false;
+    if (ec) {return;}
+    _stats.syscalls += write(false);
+    if (! busy() && _on_flush) {_on_flush();}
+  });
 }
 
 // Engine ------------------------------------------------------------------------
 
 Engine::Engine(OB::Parg& pg) : _pg {pg} {
-  _line.reserve(1000000);
+  _writer.enabled = _pg.find("output-thread");
+  _out.sync(_pg.find("sync"));
+
+  auto const catch_up = _pg.get<std::string>("catch-up");
+  if (catch_up == "skip") {_sched.policy = _sched.Skip;}
+  else if (catch_up == "burst") {_sched.policy = _sched.Burst;}
+  else {throw std::runtime_error("invalid catch-up policy '" + catch_up + "'");}
+
+  auto const bits = _pg.get<std::string>("colour-depth");
+  if (auto const depth = colour_depth(std::strtoul(bits.c_str(), nullptr, 10)); depth && bits.find_first_not_of("0123456789") == std::string::npos) {
+    _out.depth(*depth);
+  }
+  else {
+    throw std::runtime_error("invalid colour depth '" + bits + "'");
+  }
+
+  if (auto const seed = _pg.get<std::string>("seed"); seed.empty()) {
+    // a fresh one every run, the headless report prints it
+    std::random_device rd;
+    _random.seed((static_cast<std::uint64_t>(rd()) << 32) | rd());
+  }
+  else {
+    errno = 0;
+    auto const val = std::strtoull(seed.c_str(), nullptr, 10);
+    if (seed.find_first_not_of("0123456789") != std::string::npos || errno == ERANGE) {
+      throw std::runtime_error("invalid seed '" + seed + "'");
+    }
+    _random.seed(val);
+  }
+
+  if (auto const world = _pg.get<std::string>("world"); ! world.empty()) {
+    std::smatch match;
+    if (! std::regex_match(world, match, std::regex("([0-9]{1,9})x([0-9]{1,9})")) || std::stoul(match[1]) == 0 || std::stoul(match[2]) == 0) {
+      throw std::runtime_error("invalid world size '" + world + "'");
+    }
+    _world = Size(std::stoul(match[1]), std::stoul(match[2]));
+  }
+
+  _stress.bots = _pg.get<std::size_t>("stress");
+  auto const ai = _pg.get<std::string>("stress-ai");
+  if (ai == "greedy") {_stress.ai = Bot::Greedy;}
+  else if (ai == "bfs") {_stress.ai = Bot::Bfs;}
+  else {throw std::runtime_error("invalid stress ai '" + ai + "'");}
+
+  auto const fps = _pg.get<int>("fps");
+  _headless.enabled = _pg.find("headless");
+  if (fps < 0 || (fps == 0 && ! _headless.enabled)) {
+    throw std::runtime_error("invalid fps '" + std::to_string(fps) + "'");
+  }
+  // zero runs headless as fast as possible while the game steps at the default rate
+  _headless.paced = fps > 0;
+  if (fps > 0) {
+    _fps = fps;
+    _tick = static_cast<Tick>(1000000000 / _fps);
+  }
+
+  if (_headless.enabled) {
+    auto const size = _pg.get<std::string>("size");
+    std::smatch match;
+    if (! std::regex_match(size, match, std::regex("([0-9]+)x([0-9]+)")) || std::stoul(match[1]) == 0 || std::stoul(match[2]) == 0) {
+      throw std::runtime_error("invalid size '" + size + "'");
+    }
+    _headless.size = Size(std::stoul(match[1]), std::stoul(match[2]));
+    _headless.frames = _pg.get<std::size_t>("frames");
+    _headless.ticks.reserve(_headless.frames);
+
+    auto const sink = _pg.get<std::string>("sink");
+    if (sink == "null") {
+      auto const fd = ::open("/dev/null", O_WRONLY);
+      if (fd < 0) {throw std::runtime_error("could not open '/dev/null'");}
+      _out.sink(fd);
+    }
+    else if (sink == "memory") {
+      _out.sink(-1);
+    }
+    else {
+      throw std::runtime_error("invalid sink '" + sink + "'");
+    }
+  }
+  else if (auto const name = ::ttyname(STDOUT_FILENO)) {
+    // a file description of its own, non-blocking writes leave stdin and std::cout alone
+    auto const fd = ::open(name, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd >= 0) {
+      _out.sink(fd);
+      // the output thread can block, the main loop has to keep ticking
+      if (! _writer.enabled) {_out.async(_io, [&] {wake();});}
+    }
+  }
+
+  if (_pg.find("replay")) {replay(_pg.get<fs::path>("replay"));}
+  if (_pg.find("record")) {
+    _record.enabled = true;
+    _record.path = _pg.get<fs::path>("record");
+    _record.file.open(_record.path, std::ios::binary | std::ios::trunc);
+    if (! _record.file) {
+      throw std::runtime_error("could not open record '" + _record.path.string() + "'");
+    }
+  }
 }
 
 void Engine::start() {
@@ -1482,13 +3280,23 @@ void Engine::stop() {
 }
 
 void Engine::winch() {
-  Term::size(_size.w, _size.h);
+  if (_headless.enabled) {
+    _size = _headless.size;
+  }
+  else {
+    Term::size(_size.w, _size.h);
+  }
   _buf.size(_size);
   _buf_prev = _buf;
+  _redraw = true;
+  _span.assign(_size.h, {_size.w, 0});
+  _span_out.assign(_size.h, {_size.w, 0});
   _root->on_winch(_size);
+  wake();
 }
 
 void Engine::screen_init() {
+  if (_headless.enabled) {return;}
   std::cout
   << aec::cursor_hide
   << aec::screen_push
@@ -1498,10 +3306,13 @@ void Engine::screen_init() {
   << aec::screen_clear
   << aec::cursor_home
   << std::flush;
-  _term_mode.set_raw();
+  if (! _term_mode) {_term_mode.emplace();}
+  _term_mode->set_raw();
 }
 
 void Engine::screen_deinit() {
+  if (_headless.enabled || ! _term_mode) {return;}
+  _out.flush();
   std::cout
   // << aec::focus_disable
   << aec::mouse_disable
@@ -1509,7 +3320,7 @@ void Engine::screen_deinit() {
   << aec::screen_pop
   << aec::cursor_show
   << std::flush;
-  _term_mode.set_cooked();
+  _term_mode->set_cooked();
 }
 
 void Engine::lang_init() {
@@ -1518,12 +3329,191 @@ void Engine::lang_init() {
   (*_env)["fps"] = Val{Fun{str_lst("(a)"), [&](auto e) -> Xpr {
     auto x = eval(sym_xpr("a"), e);
     if (auto const v = xpr_int(&x)) {
+      if (*v <= 0) {throw std::runtime_error("expected a positive 'Int'");}
       _fps = static_cast<int>(*v);
       _tick = static_cast<Tick>(1000000000 / _fps);
       return x;
     }
     throw std::runtime_error("expected 'Int'");
   }}, _env, Val::evaled};
+
+  (*_env)["seed"] = Val{Fun{str_lst("(@)"), [&](auto e) -> Xpr {
+    auto x = eval(sym_xpr("@"), e);
+    auto& l = std::get<Lst>(x);
+    if (l.size() == 0) {
+      return num_xpr(Int(_random.seed()));
+    }
+    else if (l.size() == 1) {
+      auto x = eval(l.front(), e->current);
+      if (auto const v = xpr_int(&x)) {
+        if (*v < 0 || *v > std::numeric_limits<std::uint64_t>::max()) {throw std::runtime_error("expected an unsigned 64 bit 'Int'");}
+        _random.seed(static_cast<std::uint64_t>(*v));
+        return x;
+      }
+      throw std::runtime_error("expected 'Int'");
+    }
+    else {
+      throw std::runtime_error("expected '0' or '1' arguments");
+    }
+  }}, _env, Val::evaled};
+
+  (*_env)["damage"] = Val{Fun{str_lst("()"), [&](auto e) -> Xpr {
+    return Xpr{Lst{
+      Xpr{Lst{sym_xpr("regions"), num_xpr(Int(_damage_regions))}},
+      Xpr{Lst{sym_xpr("area"), num_xpr(Int(_out.stats().area.load()))}},
+      Xpr{Lst{sym_xpr("cells"), num_xpr(Int(_size.w * _size.h))}},
+    }};
+  }}, _env, Val::evaled};
+
+  (*_env)["catch-up"] = Val{Fun{str_lst("(@)"), [&](auto e) -> Xpr {
+    auto x = eval(sym_xpr("@"), e);
+    auto& l = std::get<Lst>(x);
+    if (l.size() == 0) {
+      return str_xpr(_sched.policy == _sched.Skip ? "skip" : "burst");
+    }
+    else if (l.size() == 1) {
+      auto x = eval(l.front(), e->current);
+      if (auto const v = xpr_str(&x)) {
+        if (v->str() == "skip") {_sched.policy = _sched.Skip;}
+        else if (v->str() == "burst") {_sched.policy = _sched.Burst;}
+        else {throw std::runtime_error("expected 'skip' or 'burst'");}
+        return x;
+      }
+      throw std::runtime_error("expected 'Str'");
+    }
+    else {
+      throw std::runtime_error("expected '0' or '1' arguments");
+    }
+  }}, _env, Val::evaled};
+
+  (*_env)["perf"] = Val{Fun{str_lst("()"), [&](auto e) -> Xpr {
+    auto const hist = [](std::string const& name, Histogram const& val) {
+      return Xpr{Lst{
+        sym_xpr(name),
+        Xpr{Lst{sym_xpr("count"), num_xpr(Int(val.count()))}},
+        Xpr{Lst{sym_xpr("mean"), num_xpr(Int(val.mean().count()))}},
+        Xpr{Lst{sym_xpr("p50"), num_xpr(Int(val.percentile(0.5).count()))}},
+        Xpr{Lst{sym_xpr("p99"), num_xpr(Int(val.percentile(0.99).count()))}},
+        Xpr{Lst{sym_xpr("max"), num_xpr(Int(val.max().count()))}},
+      }};
+    };
+    auto const& out = _out.stats();
+    Lst scenes {sym_xpr("scenes")};
+    for (auto const& [name, val] : _perf.scenes) {
+      scenes.emplace_back(Xpr{Lst{sym_xpr(name), hist("update", val.update), hist("render", val.render)}});
+    }
+    return Xpr{Lst{
+      hist("tick", _perf.tick),
+      hist("input", _perf.input),
+      hist("update", _perf.update),
+      hist("render", _perf.render),
+      hist("restart", _perf.restart),
+      hist("diff", out.diff),
+      hist("encode", out.encode),
+      hist("write", out.write),
+      hist("latency", _sched.latency),
+      hist("jitter", _sched.jitter),
+      Xpr{scenes},
+    }};
+  }}, _env, Val::evaled};
+
+  (*_env)["perf-reset"] = Val{Fun{str_lst("()"), [&](auto e) -> Xpr {
+    for (auto* hist : {&_perf.tick, &_perf.input, &_perf.update, &_perf.render, &_perf.restart, &_out.stats().diff, &_out.stats().encode, &_out.stats().write, &_sched.latency, &_sched.jitter}) {
+      hist->clear();
+    }
+    for (auto& [name, val] : _perf.scenes) {
+      val.update.clear();
+      val.render.clear();
+    }
+    _perf.recent.fill(0ms);
+    return sym_xpr("T");
+  }}, _env, Val::evaled};
+
+  (*_env)["idle"] = Val{Fun{str_lst("()"), [&](auto e) -> Xpr {
+    return Xpr{Lst{
+      Xpr{Lst{sym_xpr("ticks"), num_xpr(Int(_idle.ticks))}},
+      Xpr{Lst{sym_xpr("sleeps"), num_xpr(Int(_idle.sleeps))}},
+      Xpr{Lst{sym_xpr("frames"), num_xpr(Int(_frames))}},
+    }};
+  }}, _env, Val::evaled};
+
+  (*_env)["sgr-cache"] = Val{Fun{str_lst("()"), [&](auto e) -> Xpr {
+    auto const& stats = _out.stats();
+    return Xpr{Lst{
+      Xpr{Lst{sym_xpr("hit"), num_xpr(Int(stats.sgr_hit.load()))}},
+      Xpr{Lst{sym_xpr("miss"), num_xpr(Int(stats.sgr_miss.load()))}},
+      Xpr{Lst{sym_xpr("saved"), num_xpr(Int(stats.sgr_saved.load()))}},
+    }};
+  }}, _env, Val::evaled};
+
+  (*_env)["output"] = Val{Fun{str_lst("()"), [&](auto e) -> Xpr {
+    return Xpr{Lst{
+      Xpr{Lst{sym_xpr("thread"), num_xpr(Int(_writer.enabled))}},
+      Xpr{Lst{sym_xpr("depth"), num_xpr(Int(_writer.queue.size()))}},
+      Xpr{Lst{sym_xpr("dropped"), num_xpr(Int(_writer.dropped))}},
+      Xpr{Lst{sym_xpr("coalesced"), num_xpr(Int(_writer.coalesced.load()))}},
+      Xpr{Lst{sym_xpr("merged"), num_xpr(Int(_out.stats().merged.load()))}},
+      Xpr{Lst{sym_xpr("full"), num_xpr(Int(_out.stats().full.load()))}},
+      Xpr{Lst{sym_xpr("frames"), num_xpr(Int(_out.stats().frames.load()))}},
+      Xpr{Lst{sym_xpr("bytes"), num_xpr(Int(_out.stats().bytes.load()))}},
+      Xpr{Lst{sym_xpr("syscalls"), num_xpr(Int(_out.stats().syscalls.load()))}},
+      Xpr{Lst{sym_xpr("frame-bytes"), num_xpr(Int(_out.stats().frame_bytes.load()))}},
+      Xpr{Lst{sym_xpr("frame-syscalls"), num_xpr(Int(_out.stats().frame_syscalls.load()))}},
+    }};
+  }}, _env, Val::evaled};
+
+  (*_env)["input"] = Val{Fun{str_lst("(a b)"), [&](auto e) -> Xpr {
+    auto a = eval(sym_xpr("a"), e);
+    auto b = eval(sym_xpr("b"), e);
+    auto const n = xpr_int(&a);
+    if (! n || *n < 0) {throw std::runtime_error("expected 'Int'");}
+    auto const s = xpr_str(&b);
+    if (! s) {throw std::runtime_error("expected 'Str'");}
+    // the recording already holds the keys queued by the script
+    if (_replay.enabled) {return a;}
+    auto const tick = static_cast<std::size_t>(*n);
+    auto const str = s->str();
+    if (auto const key = Read::Key::map.find(str); key != Read::Key::map.end()) {
+      _input_queue.emplace(tick, Read::Key{str, key->second});
+      return a;
+    }
+    // queue each character as its own key press
+    for (auto const& ch : Text::View(str)) {
+      _input_queue.emplace(tick, Read::Key{std::string(ch.str), OB::Term::utf8_to_char32(ch.str)});
+    }
+    return a;
+  }}, _env, Val::evaled};
+
+  (*_env)["sync"] = Val{Fun{str_lst("(a)"), [&](auto e) -> Xpr {
+    auto x = eval(sym_xpr("a"), e);
+    if (auto const v = xpr_int(&x)) {
+      _out.sync(*v != 0);
+      return x;
+    }
+    throw std::runtime_error("expected 'Int'");
+  }}, _env, Val::evaled};
+
+  (*_env)["colour-depth"] = Val{Fun{str_lst("(@)"), [&](auto e) -> Xpr {
+    auto x = eval(sym_xpr("@"), e);
+    auto& l = std::get<Lst>(x);
+    if (l.size() == 0) {
+      return num_xpr(static_cast<Int>(colour_bits(_out.depth())));
+    }
+    else if (l.size() == 1) {
+      auto x = eval(l.front(), e->current);
+      if (auto const v = xpr_int(&x)) {
+        if (auto const depth = colour_depth(static_cast<std::size_t>(*v)); depth && *v > 0) {
+          _out.depth(*depth);
+          return x;
+        }
+        throw std::runtime_error("expected '24', '8', '4', or '2'");
+      }
+      throw std::runtime_error("expected 'Int'");
+    }
+    else {
+      throw std::runtime_error("expected '0' or '1' arguments");
+    }
+  }}, _env, Val::evaled};
 }
 
 void Engine::await_signal() {
@@ -1532,6 +3522,11 @@ void Engine::await_signal() {
     stop();
   });
 
+  if (_headless.enabled) {
+    _sig.wait();
+    return;
+  }
+
   _sig.on_signal(SIGWINCH, [&](auto const& ec, auto sig) {
     // std::cerr << "\nEvent: " << Belle::Signal::str(sig) << "\n";
     _sig.wait();
@@ -1542,8 +3537,9 @@ void Engine::await_signal() {
     // std::cerr << "\nEvent: " << Belle::Signal::str(sig) << "\n";
     _sig.wait();
     _timer.cancel();
-    auto const snake = std::dynamic_pointer_cast<Snake>(std::dynamic_pointer_cast<Root>(_root)->_scenes.at("snake"));
+    auto const snake = _root->_scene.snake;
     snake->_state = Snake::State::Stopped;
+    writer_stop();
     screen_deinit();
     kill(getpid(), SIGSTOP);
   });
@@ -1553,7 +3549,9 @@ void Engine::await_signal() {
     _sig.wait();
     screen_init();
     winch();
+    writer_start();
     _tick_begin = Clock::now();
+    _sched.last = _tick_begin;
     await_tick();
   });
 
@@ -1562,30 +3560,82 @@ void Engine::await_signal() {
 
 void Engine::await_read() {
   _read.on_read([&](auto const& ctx) {
-    auto nctx = ctx;
-    bool found {false};
-    std::visit([&](auto& e) {found = on_read(e);}, nctx);
-    if (!found) {
-      if (auto const& x = std::get_if<Mouse>(&nctx)) {
-        _buf.col(Pos(x->pos.x, x->pos.y)).scene->on_input(nctx);
-      }
-      else {
-        _root->on_input(nctx);
+    if (_replay.enabled) {
+      // the recording plays the game, only quitting and suspending go through
+      if (auto const key = std::get_if<Read::Key>(&ctx)) {
+        if (key->ch == OB::Term::ctrl_key('c') || key->ch == OB::Term::ctrl_key('z')) {
+          auto nkey = *key;
+          on_read(nkey);
+        }
       }
+      return;
     }
+    input(ctx);
   });
 
   _read.run();
 }
 
+void Engine::input(Read::Ctx const& ctx) {
+  OB::Timer<std::chrono::steady_clock> timer;
+  timer.clear();
+  timer.start();
+  if (_record.enabled) {record(ctx);}
+  auto nctx = ctx;
+  bool found {false};
+  std::visit([&](auto& e) {found = on_read(e);}, nctx);
+  if (!found) {
+    if (auto const& x = std::get_if<Mouse>(&nctx)) {
+      // the last frame drawn
+      _buf.at(Pos(x->pos.x, _size.h - x->pos.y - 1)).scene->on_input(nctx);
+    }
+    else {
+      _root->on_input(nctx);
+    }
+  }
+  wake();
+  timer.stop();
+  _perf.input.add(timer.time<Tick>());
+}
+
 void Engine::await_tick() {
-  auto const delta = std::chrono::duration_cast<Tick>(_tick - _tick_timer.time<Tick>());
-  if (delta >= 0ms) {
-    _timer.expires_at(_tick_timer.end() + delta);
+  if (_headless.enabled && ! _headless.paced) {
+    Belle::asio::post(_io, [&] {on_tick();});
+    return;
   }
-  else {
-    _timer.expires_at(_tick_timer.end() + (_tick - (_tick_timer.time<Tick>() % _tick)));
+  auto wait = _tick;
+  _idle.sleep = false;
+  if (! _headless.enabled && ! _dirty && ! _pending) {
+    // nothing is due before the next tick, sleep until the earliest scene deadline
+    auto const deadline = _root->deadline();
+    if (deadline > _tick) {
+      // whole ticks, staying on the grid
+      auto const ticks = std::min(deadline, static_cast<Tick>(std::chrono::hours(1))) / _tick + 1;
+      wait = _tick * ticks;
+      _idle.sleep = true;
+      _idle.slept = true;
+      ++_idle.sleeps;
+    }
+  }
+
+  auto const now = Clock::now();
+  auto next = _sched.last + wait;
+  if (next <= now) {
+    // whole ticks missed after the late one
+    auto const behind = static_cast<std::size_t>((now - next) / _tick);
+    if (_idle.slept || _sched.policy == _sched.Skip) {
+      // wait for the first tick after now
+      next += _tick * (behind + 1);
+      if (! _idle.slept) {_fps_dropped += static_cast<int>(behind + 1);}
+    }
+    else if (behind > _sched.burst) {
+      // run a bounded number of ticks back to back
+      next += _tick * (behind - _sched.burst);
+      _fps_dropped += static_cast<int>(behind - _sched.burst);
+    }
   }
+  _sched.next = next;
+  _timer.expires_at(next);
   _timer.async_wait([&](auto ec) {
     if (ec) {return;}
     on_tick();
@@ -1594,98 +3644,155 @@ void Engine::await_tick() {
 
 void Engine::on_tick() {
   _tick_end = Clock::now();
-  auto delta = std::chrono::duration_cast<Tick>(_tick_end - _tick_begin);
+  auto const interval = std::chrono::duration_cast<Tick>(_tick_end - _tick_begin);
+  bool const slept {_idle.slept};
+  _idle.slept = false;
+  _idle.sleep = false;
+
+  auto delta = interval;
+  if (_headless.enabled || _record.enabled || _replay.enabled) {
+    // headless, recorded and replayed runs advance the game by a fixed step so they repeat exactly
+    delta = _tick;
+  }
+  else {
+    auto const scheduled = std::chrono::duration_cast<Tick>(_sched.next - _sched.last);
+    _sched.latency.add(std::chrono::duration_cast<Tick>(_tick_end - _sched.next));
+    if (! slept && _frames) {
+      _sched.jitter.add(interval > scheduled ? interval - scheduled : scheduled - interval);
+    }
+    // bursts replay missed ticks with the step they were scheduled for
+    if (_sched.policy == _sched.Burst) {delta = scheduled;}
+    _sched.last = _sched.next;
+  }
+
   _time += delta;
   _tick_begin = _tick_end;
-  if (delta.count() > 0) {
-    _fps_actual = std::round(1000000000.0 / delta.count());
-  }
-  if (delta > _tick) {
-    int const dropped {static_cast<int>((delta.count() / _tick.count())) - 1};
-    _fps_dropped += dropped;
+  if (interval.count() > 0 && ! slept) {
+    _fps_actual = std::round(1000000000.0 / interval.count());
   }
 
   _tick_timer.clear();
   _tick_timer.start(_tick_begin);
 
-  _root->on_update(delta);
-  _root->on_render(_buf);
-
-  for (std::size_t y = 0; y < _buf.size().h; ++y) {
-    for (std::size_t x = 0; x < _buf.size().w; ++x) {
-      auto const& cell = _buf.at(Pos(x, y));
-      auto const& prev = _buf_prev.at(Pos(x, y));
-
-      if ((cell.text != prev.text) ||
-          (cell.style.attr != prev.style.attr) ||
-          (cell.style.type != prev.style.type) ||
-          (cell.style.fg.r != prev.style.fg.r || cell.style.fg.g != prev.style.fg.g || cell.style.fg.b != prev.style.fg.b) ||
-          (cell.style.bg.r != prev.style.bg.r || cell.style.bg.g != prev.style.bg.g || cell.style.bg.b != prev.style.bg.b)) {
-
-        bool diff_attr {_style.attr != cell.style.attr};
-        bool diff_type {_style.type != cell.style.type};
-        bool diff_fg {_style.fg.r != cell.style.fg.r || _style.fg.g != cell.style.fg.g || _style.fg.b != cell.style.fg.b};
-        bool diff_bg {_style.bg.r != cell.style.bg.r || _style.bg.g != cell.style.bg.g || _style.bg.b != cell.style.bg.b};
-
-        _line += aec::cursor_set(x + 1, y + 1);
-
-        if (diff_attr) {
-          _style = Style();
-          _style.attr = cell.style.attr;
-          _line += aec::clear;
-          diff_fg = true;
-          diff_bg = true;
-          if (_style.attr != Style::Null) {
-            if (_style.attr & Style::Bold) {_line += aec::bold;}
-            if (_style.attr & Style::Reverse) {_line += aec::reverse;}
-          }
-        }
+  while (_input_queue.size() && _input_queue.begin()->first <= _frames) {
+    auto const ctx = _input_queue.begin()->second;
+    _input_queue.erase(_input_queue.begin());
+    input(ctx);
+  }
 
-        if (diff_type) {
-          _style.type = cell.style.type;
-        }
+  OB::Timer<std::chrono::steady_clock> timer;
+  timer.clear();
+  timer.start();
+  bool const changed {_root->on_update(delta)};
+  timer.stop();
+  _perf.update.add(timer.time<Tick>());
 
-        if (_style.type == Style::Bit_24) {
-          if (diff_fg) {
-            _style.fg = cell.style.fg;
-            _line += "\x1b[38;2;";
-            _line += std::to_string(_style.fg.r);
-            _line += ";";
-            _line += std::to_string(_style.fg.g);
-            _line += ";";
-            _line += std::to_string(_style.fg.b);
-            _line += "m";
-          }
+  if (_record.enabled) {record_tick();}
+  if (_replay.enabled && ! _replay.desync && _frames < _replay.hash.size() && _root->hash() != _replay.hash.at(_frames)) {
+    _replay.desync = _frames;
+  }
 
-          if (diff_bg) {
-            _style.bg = cell.style.bg;
-            _line += "\x1b[48;2;";
-            _line += std::to_string(_style.bg.r);
-            _line += ";";
-            _line += std::to_string(_style.bg.g);
-            _line += ";";
-            _line += std::to_string(_style.bg.b);
-            _line += "m";
-          }
-        }
+  if (! changed && ! _dirty && ! _redraw && ! _pending) {
+    // nothing changed, the last frame is still on screen
+    ++_idle.ticks;
+  }
+  else {
+    if (_dirty) {
+      // input may have changed any scene
+      _dirty = false;
+      _root->dirty();
+    }
+    _pending = false;
+    timer.clear();
+    timer.start();
+    _root->on_render(_buf);
+    timer.stop();
+    _perf.render.add(timer.time<Tick>());
+
+    // only diff the regions recomposed this frame
+    _damage_regions = _buf.damage().size();
+    for (auto const& rect : _buf.damage()) {
+      auto const x_end = std::min(rect.pos.x + rect.size.w, _size.w);
+      auto const y_end = std::min(rect.pos.y + rect.size.h, _size.h);
+      for (std::size_t y = rect.pos.y; y < y_end; ++y) {
+        auto& span = _span.at(y);
+        span.first = std::min(span.first, rect.pos.x);
+        span.second = std::max(span.second, x_end);
+      }
+    }
+    _buf.damage().clear();
 
-        _line += cell.text;
+    for (std::size_t y = 0; y < _size.h; ++y) {
+      auto& span = _span_out.at(y);
+      span.first = std::min(span.first, _span.at(y).first);
+      span.second = std::max(span.second, _span.at(y).second);
+    }
+    _span.assign(_size.h, {_size.w, 0});
+
+    if (_writer.enabled) {
+      if (_writer.failed) {std::rethrow_exception(_writer.error);}
+      if (auto const frame = _writer.queue.back()) {
+        frame->buf.copy(_buf);
+        frame->span = _span_out;
+        frame->redraw = _redraw;
+        {
+          std::lock_guard<std::mutex> lock {_writer.mutex};
+          _writer.queue.push();
+        }
+        _writer.cond.notify_one();
+        _span_out.assign(_size.h, {_size.w, 0});
+        _redraw = false;
       }
+      else {
+        // the terminal is behind, carry the changed range over to the next frame
+        ++_writer.dropped;
+        _pending = true;
+      }
+    }
+    else if (_out.busy()) {
+      // the terminal is still taking the last frame, keep diffing against it
+      // and carry the changed range over, the flush wakes the next tick
+      ++_out.stats().merged;
+      _pending = true;
+    }
+    else {
+      if (_redraw) {
+        _redraw = false;
+        _out.size(_size);
+      }
+      _out.frame(_buf, _buf_prev, _span_out);
+      _span_out.assign(_size.h, {_size.w, 0});
     }
-    _bsize += _line.size();
-    write();
   }
-  // if (_bsize) {
-  //   std::cerr << "write> " << _bsize << "\n";
-  // }
-  _bsize = 0;
-  _buf_prev = _buf;
 
   ++_frames;
   _tick_timer.stop();
+  _perf.tick.add(_tick_timer.time<Tick>());
+  _perf.recent.at(_perf.idx) = _tick_timer.time<Tick>();
+  _perf.idx = (_perf.idx + 1) % _perf.recent.size();
+  if (_headless.enabled) {
+    _headless.ticks.emplace_back(_tick_timer.time<Tick>());
+    if (_frames >= _headless.frames) {
+      stop();
+      return;
+    }
+  }
+  if (_replay.enabled && _frames >= _replay.ticks) {
+    stop();
+    return;
+  }
   await_tick();
 }
 
+// render the next tick, cutting an idle sleep short
+void Engine::wake() {
+  _dirty = true;
+  if (! _idle.sleep) {return;}
+  _idle.sleep = false;
+  // the handler may already be queued, only reschedule a wait that was cancelled
+  if (_timer.cancel()) {await_tick();}
+}
+
 bool Engine::on_read(Read::Null& ctx) {
   // TODO log error
   // std::cerr << "read> null: " << hex_encode(ctx.str) << "\n";
@@ -1726,22 +3833,276 @@ bool Engine::on_read(Read::Key& ctx) {
   return false;
 }
 
-void Engine::write() {
-  if (_line.empty()) {return;}
-  int num {0};
-  char const* ptr {_line.data()};
-  std::size_t size {_line.size()};
-  // std::cerr << "write> " << size << "\n";
-  while (size > 0 && static_cast<std::size_t>(num = ::write(STDIN_FILENO, ptr, size)) != size) {
-    if (num < 0) {
-      if (errno == EINTR || errno == EAGAIN) {continue;}
-      throw std::runtime_error("write failed");
+void Engine::script(fs::path const& path) {
+  std::ifstream file {path};
+  if (! file) {
+    throw std::runtime_error("could not open script '" + path.string() + "'");
+  }
+  // one expression per line, blank lines and ';' comments are skipped
+  std::string line;
+  for (std::size_t num = 1; std::getline(file, line); ++num) {
+    auto const str = Text::trim(line);
+    if (str.empty() || str.front() == ';') {continue;}
+    try {
+      if (auto x = read(std::string_view(str))) {
+        eval(*x, _env);
+      }
+    }
+    catch (std::exception const& e) {
+      throw std::runtime_error(path.string() + ":" + std::to_string(num) + ": " + e.what());
+    }
+  }
+}
+
+void Engine::record(Read::Ctx const& ctx) {
+  // keys that quit or suspend the game would do the same to its replay
+  if (auto const key = std::get_if<Read::Key>(&ctx)) {
+    if (key->ch == OB::Term::ctrl_key('c') || key->ch == OB::Term::ctrl_key('z')) {return;}
+  }
+  _record.buf.clear();
+  std::visit([&](auto const& e) {
+    using T = std::decay_t<decltype(e)>;
+    auto kind = Null_entry;
+    if constexpr (std::is_same_v<T, Read::Key>) {kind = Key_entry;}
+    if constexpr (std::is_same_v<T, Read::Mouse>) {kind = Mouse_entry;}
+    varint_encode(_record.buf, ((_frames - _record.tick) << 3) | kind);
+    varint_encode(_record.buf, e.ch);
+    if constexpr (std::is_same_v<T, Read::Mouse>) {
+      varint_encode(_record.buf, e.pos.x);
+      varint_encode(_record.buf, e.pos.y);
+    }
+    varint_encode(_record.buf, e.str.size());
+    _record.buf += e.str;
+  }, ctx);
+  _record.tick = _frames;
+  _record.file.write(_record.buf.data(), static_cast<std::streamsize>(_record.buf.size()));
+}
+
+void Engine::record_start() {
+  // the header holds what the game needs to start out the same
+  _record.buf = "nyble";
+  varint_encode(_record.buf, 2);
+  varint_encode(_record.buf, _random.seed());
+  varint_encode(_record.buf, _size.w);
+  varint_encode(_record.buf, _size.h);
+  varint_encode(_record.buf, static_cast<std::uint64_t>(_tick.count()));
+  varint_encode(_record.buf, _stress.bots);
+  varint_encode(_record.buf, _stress.ai);
+  varint_encode(_record.buf, _world.w);
+  varint_encode(_record.buf, _world.h);
+  _record.tick = 0;
+  _record.file.write(_record.buf.data(), static_cast<std::streamsize>(_record.buf.size()));
+}
+
+void Engine::record_tick() {
+  auto const hash = _root->hash();
+  _record.buf.clear();
+  varint_encode(_record.buf, ((_frames - _record.tick) << 3) | Hash_entry);
+  for (int i = 0; i < 32; i += 8) {
+    _record.buf += static_cast<char>((hash >> i) & 0xff);
+  }
+  _record.tick = _frames;
+  _record.file.write(_record.buf.data(), static_cast<std::streamsize>(_record.buf.size()));
+}
+
+void Engine::record_stop() {
+  _record.buf.clear();
+  varint_encode(_record.buf, ((_frames - _record.tick) << 3) | End_entry);
+  _record.tick = _frames;
+  _record.file.write(_record.buf.data(), static_cast<std::streamsize>(_record.buf.size()));
+  _record.file.flush();
+  if (! _record.file) {
+    throw std::runtime_error("could not write record '" + _record.path.string() + "'");
+  }
+}
+
+void Engine::replay(fs::path const& path) {
+  std::ifstream file {path, std::ios::binary};
+  if (! file) {
+    throw std::runtime_error("could not open replay '" + path.string() + "'");
+  }
+  std::string const data {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+  std::string_view buf {data};
+  auto const invalid = [&](std::string const& what) {
+    return std::runtime_error("invalid replay '" + path.string() + "', " + what);
+  };
+  if (buf.substr(0, 5) != "nyble") {throw invalid("not a recording");}
+  buf.remove_prefix(5);
+  auto const num = [&] {
+    if (auto const val = varint_decode(buf)) {return *val;}
+    throw invalid("truncated entry");
+  };
+  auto const str = [&] {
+    auto const size = num();
+    if (size > buf.size()) {throw invalid("truncated entry");}
+    std::string res {buf.substr(0, size)};
+    buf.remove_prefix(size);
+    return res;
+  };
+
+  if (num() != 2) {throw invalid("unknown version");}
+  _random.seed(num());
+  _replay.size.w = num();
+  _replay.size.h = num();
+  _tick = Tick(num());
+  if (_tick <= 0ms) {throw invalid("tick of zero");}
+  _fps = static_cast<int>(std::round(1000000000.0 / _tick.count()));
+  _stress.bots = num();
+  _stress.ai = num() == Bot::Bfs ? Bot::Bfs : Bot::Greedy;
+  _world.w = num();
+  _world.h = num();
+  if ((_world.w == 0) != (_world.h == 0)) {throw invalid("world size of zero");}
+
+  std::size_t tick {0};
+  bool end {false};
+  while (! buf.empty() && ! end) {
+    auto const head = num();
+    tick += head >> 3;
+    switch (head & 0x7) {
+      case Key_entry: {
+        auto const ch = static_cast<char32_t>(num());
+        _input_queue.emplace(tick, Read::Key{str(), ch});
+        break;
+      }
+      case Mouse_entry: {
+        Read::Mouse mouse;
+        mouse.ch = static_cast<char32_t>(num());
+        mouse.pos.x = num();
+        mouse.pos.y = num();
+        mouse.str = str();
+        _input_queue.emplace(tick, mouse);
+        break;
+      }
+      case Null_entry: {
+        auto const ch = static_cast<char32_t>(num());
+        _input_queue.emplace(tick, Read::Null{str(), ch});
+        break;
+      }
+      case Hash_entry: {
+        if (buf.size() < 4) {throw invalid("truncated entry");}
+        std::uint32_t hash {0};
+        for (int i = 0; i < 32; i += 8) {
+          hash |= static_cast<std::uint32_t>(static_cast<std::uint8_t>(buf.front())) << i;
+          buf.remove_prefix(1);
+        }
+        _replay.hash.resize(tick + 1, 0);
+        _replay.hash.at(tick) = hash;
+        break;
+      }
+      case End_entry: {
+        end = true;
+        break;
+      }
+      default: {
+        throw invalid("unknown entry");
+      }
+    }
+  }
+  // a run that ended without stopping still plays up to its last tick
+  _replay.ticks = end ? tick : _replay.hash.size();
+
+  _replay.enabled = true;
+  if (_headless.enabled) {
+    _headless.size = _replay.size;
+    _headless.frames = _replay.ticks;
+    _headless.ticks.reserve(_headless.frames);
+  }
+}
+
+void Engine::report() {
+  auto const time = std::chrono::duration_cast<std::chrono::duration<double>>(Clock::now() - _headless.begin).count();
+  auto const frames = static_cast<double>(std::max<std::size_t>(_frames, 1));
+  auto& ticks = _headless.ticks;
+  std::sort(ticks.begin(), ticks.end());
+  auto const percentile = [&](double const val) {
+    if (ticks.empty()) {return 0.0;}
+    auto const idx = static_cast<std::size_t>(val * static_cast<double>(ticks.size() - 1) + 0.5);
+    return std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(ticks.at(idx)).count();
+  };
+  auto const ms = [](Tick const val) {
+    return std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(val).count();
+  };
+  auto const& stats = _out.stats();
+  std::cout
+  << "size " << _size.w << "x" << _size.h << "\n"
+  << "world " << _root->_grid.size().w << "x" << _root->_grid.size().h << "\n"
+  << "chunks " << _root->_grid.chunks() << "\n"
+  << "bots " << _stress.bots << "\n"
+  << "seed " << _random.seed() << "\n"
+  << "replay " << (! _replay.enabled ? "off" : _replay.desync ? "desync" : "ok") << "\n"
+  << "frames " << _frames << "\n"
+  << "time " << time << " s\n"
+  << "frames/sec " << (time > 0 ? static_cast<double>(_frames) / time : 0.0) << "\n"
+  << "bytes/frame " << static_cast<double>(stats.bytes) / frames << "\n"
+  << "syscalls/frame " << static_cast<double>(stats.syscalls) / frames << "\n"
+  << "tick p50 " << percentile(0.50) << " ms\n"
+  << "tick p99 " << percentile(0.99) << " ms\n"
+  << "update p50 " << ms(_perf.update.percentile(0.50)) << " ms\n"
+  << "update p99 " << ms(_perf.update.percentile(0.99)) << " ms\n"
+  << "render p50 " << ms(_perf.render.percentile(0.50)) << " ms\n"
+  << "render p99 " << ms(_perf.render.percentile(0.99)) << " ms\n"
+  << "restarts " << _perf.restart.count() << "\n"
+  << "restart max " << ms(_perf.restart.max()) << " ms\n"
+  << std::flush;
+}
+
+void Engine::writer_start() {
+  if (! _writer.enabled || _writer.thread.joinable()) {return;}
+  _writer.stop = false;
+  _writer.thread = std::thread([&] {writer_run();});
+}
+
+void Engine::writer_stop() {
+  if (! _writer.thread.joinable()) {return;}
+  {
+    std::lock_guard<std::mutex> lock {_writer.mutex};
+    _writer.stop = true;
+  }
+  _writer.cond.notify_one();
+  _writer.thread.join();
+}
+
+void Engine::writer_run() {
+  try {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock {_writer.mutex};
+        _writer.cond.wait(lock, [&] {return _writer.stop || ! _writer.queue.empty();});
+        if (_writer.queue.empty()) {return;}
+      }
+
+      // skip to the newest frame, merging the changed ranges of the ones passed over
+      auto frame = _writer.queue.front();
+      bool redraw {frame->redraw};
+      _writer.span = frame->span;
+      while (_writer.queue.size() > 1) {
+        _writer.queue.pop();
+        ++_writer.coalesced;
+        frame = _writer.queue.front();
+        redraw = redraw || frame->redraw || frame->span.size() != _writer.span.size();
+        if (redraw) {continue;}
+        for (std::size_t y = 0; y < _writer.span.size(); ++y) {
+          auto& span = _writer.span.at(y);
+          span.first = std::min(span.first, frame->span.at(y).first);
+          span.second = std::max(span.second, frame->span.at(y).second);
+        }
+      }
+
+      auto const size = frame->buf.size();
+      if (redraw || _writer.prev.size().w != size.w || _writer.prev.size().h != size.h) {
+        _writer.prev.size(size);
+        _writer.span.assign(size.h, {0, size.w});
+        _out.size(size);
+      }
+      _out.frame(frame->buf, _writer.prev, _writer.span);
+      std::swap(frame->buf, _writer.prev);
+      _writer.queue.pop();
     }
-    size -= static_cast<std::size_t>(num);
-    ptr += static_cast<std::size_t>(num);
-    // std::cerr << "write> " << size << "\n";
   }
-  _line.clear();
+  catch (...) {
+    _writer.error = std::current_exception();
+    _writer.failed = true;
+  }
 }
 
 void Engine::run() {
@@ -1749,15 +4110,30 @@ void Engine::run() {
     screen_init();
     _root = std::make_shared<Root>(this);
     winch();
+    if (_replay.enabled && (_size.w != _replay.size.w || _size.h != _replay.size.h)) {
+      throw std::runtime_error("replay needs a " + std::to_string(_replay.size.w) + "x" + std::to_string(_replay.size.h) + " screen");
+    }
+    if (_record.enabled) {record_start();}
     lang_init();
+    if (_pg.find("script")) {script(_pg.get<fs::path>("script"));}
     await_signal();
-    await_read();
+    if (! _headless.enabled) {await_read();}
     _tick_begin = Clock::now();
+    _headless.begin = _tick_begin;
+    _sched.last = _tick_begin;
     await_tick();
+    writer_start();
     start();
+    writer_stop();
     screen_deinit();
+    if (_record.enabled) {record_stop();}
+    if (_headless.enabled) {report();}
+    if (_replay.desync) {
+      throw std::runtime_error("replay desync at tick " + std::to_string(*_replay.desync));
+    }
   }
   catch(...) {
+    writer_stop();
     screen_deinit();
     throw;
   }
@@ -50,6 +50,8 @@ SOFTWARE.
 #include "ob/text.hh"
 #include "ob/term.hh"
 #include "ob/lispp.hh"
+#include "ob/ring.hh"
+#include "ob/spsc.hh"
 #include "ob/timer.hh"
 #include "ob/color.hh"
 #include "ob/readline.hh"
@@ -60,20 +62,29 @@ SOFTWARE.
 #include <cstddef>
 #include <cstdint>
 
+#include <array>
+#include <mutex>
+#include <atomic>
 #include <deque>
+#include <map>
 #include <regex>
 #include <chrono>
 #include <memory>
+#include <optional>
 #include <string>
 #include <thread>
+#include <type_traits>
 #include <vector>
 #include <utility>
 #include <fstream>
 #include <iostream>
+#include <string_view>
 #include <sstream>
 #include <algorithm>
 #include <filesystem>
 #include <functional>
+#include <exception>
+#include <condition_variable>
 #include <unordered_map>
 
 namespace Nyble {
@@ -120,6 +131,18 @@ struct Size {
   Size& operator=(Size const&) = default;
 };
 
+struct Rect {
+  Pos pos;
+  Size size;
+  Rect(Pos const& pos, Size const& size) : pos {pos}, size {size} {}
+  Rect() = default;
+  Rect(Rect&&) = default;
+  Rect(Rect const&) = default;
+  ~Rect() = default;
+  Rect& operator=(Rect&&) = default;
+  Rect& operator=(Rect const&) = default;
+};
+
 struct Color {
   std::uint8_t r {0};
   std::uint8_t g {0};
@@ -154,13 +177,48 @@ struct Style {
   Color bg;
 };
 
+bool operator==(Style const& lhs, Style const& rhs);
+bool operator!=(Style const& lhs, Style const& rhs);
+
+std::size_t text_cols(std::string_view const str);
+
 class Scene;
 
+// an interned grapheme cluster, stored as a small id so cells stay trivially copyable
+struct Glyph {
+  std::uint32_t id {0};
+  explicit Glyph(std::string_view const str);
+  Glyph(std::string_view const str, std::size_t const cols);
+  Glyph() = default;
+  Glyph(Glyph&&) = default;
+  Glyph(Glyph const&) = default;
+  ~Glyph() = default;
+  Glyph& operator=(Glyph&&) = default;
+  Glyph& operator=(Glyph const&) = default;
+  std::string_view str() const;
+  std::size_t cols() const;
+  // number of distinct glyphs interned so far
+  static std::size_t count();
+};
+
+bool operator==(Glyph const& lhs, Glyph const& rhs);
+bool operator!=(Glyph const& lhs, Glyph const& rhs);
+
 struct Cell {
+  Scene* scene {nullptr};
+  int zidx {0};
+  Style style;
+  Glyph text;
+};
+
+static_assert(std::is_trivially_copyable_v<Cell>);
+
+// a run of text written at the buffer cursor
+struct Span {
   Scene* scene;
   int zidx;
   Style style;
-  std::string text;
+  std::string_view text;
 };
 
 class Buffer {
@@ -171,30 +229,298 @@ public:
   ~Buffer() = default;
   Buffer& operator=(Buffer&&) = default;
   Buffer& operator=(Buffer const&) = default;
+  void operator()(Span const& span);
   void operator()(Cell const& cell);
+  // copy the cells of buf without allocating when the sizes match
+  void copy(Buffer const& buf);
   Cell& at(Pos const& pos);
-  std::vector<Cell>& row(std::size_t y);
+  Cell* row(std::size_t y);
   Cell& col(Pos const& pos);
+  // nullptr when a cell of a higher layer covers the position
+  Cell* col(Pos const& pos, int const zidx);
   Pos cursor();
   void cursor(Pos const& pos);
   Size size();
   void size(Size const& size);
+  // regions written since the last clear, in top-down screen coordinates
+  std::vector<Rect>& damage();
+  void damage(Rect const& rect);
   bool empty();
   void clear();
 
 private:
+  void damage(std::size_t const x, std::size_t const y);
+  void advance();
+
   Pos _pos;
   Size _size;
-  std::vector<std::vector<Cell>> _value;
+  // row-major, top-down
+  std::vector<Cell> _value;
+  std::vector<Rect> _damage;
+  // reused between writes to keep its capacity
+  Text::View _view;
 }; // class Buffer
 
+class Encoder final {
+public:
+  struct Stats {
+    std::size_t sgr_hit {0};
+    std::size_t sgr_miss {0};
+    // bytes not written compared to emitting each attribute and colour separately
+    std::size_t sgr_saved {0};
+  };
+
+  Encoder() = default;
+  Encoder(Encoder&&) = default;
+  Encoder(Encoder const&) = default;
+  ~Encoder() = default;
+  Encoder& operator=(Encoder&&) = default;
+  Encoder& operator=(Encoder const&) = default;
+  void size(Size const& size);
+  void reset();
+  void redraw();
+  void cursor(Pos const& pos);
+  // colour depth styles are quantized to, resets the style state
+  void depth(std::uint8_t const type);
+  std::uint8_t depth();
+  void style(Style const& style);
+  void text(std::string_view const str, std::size_t const cols);
+  std::string& str();
+  Stats& stats();
+  bool empty();
+  void clear();
+
+private:
+  enum class Sgr {Full, Fg, Bg};
+
+  void num(std::string& str, std::size_t const val);
+  void num(std::size_t const val);
+  std::size_t num_size(std::size_t const val);
+  void csi(std::size_t const val, char const ch);
+  std::size_t csi_size(std::size_t const val);
+  std::size_t col_size(std::size_t const from, std::size_t const to);
+  void col(std::size_t const from, std::size_t const to);
+  static std::uint8_t xterm_256(Color const& color);
+  static std::uint8_t xterm_16(Color const& color);
+  Style convert(Style const& style);
+  std::uint64_t sgr_key(Sgr const type, Style const& style);
+  std::size_t sgr_size(Color const& color);
+  void sgr_color(std::string& str, bool const bg, std::uint8_t const type, Color const& color);
+  std::string const& sgr(Sgr const type, Style const& style);
+  std::string const& sgr_attr(std::uint8_t const from, std::uint8_t const to);
+
+  Size _size;
+  // terminal cursor position, 0-based, top-down
+  Pos _pos;
+  bool _pos_valid {false};
+  std::uint8_t _depth {Style::Bit_24};
+  // last style requested and the converted style the terminal is in
+  // below Bit_24 the red channel holds the palette index
+  Style _style_in;
+  Style _style;
+  bool _style_valid {false};
+  std::string _value;
+  // prebuilt escape sequences keyed by packed style or colour
+  std::unordered_map<std::uint64_t, std::string> _sgr;
+  std::size_t _sgr_max {4096};
+  Stats _stats;
+}; // class Encoder
+
+// fixed size duration histogram, four buckets per power of two nanoseconds
+// one thread may add samples while others read them
+class Histogram final {
+public:
+  Histogram() = default;
+  Histogram(Histogram&&) = delete;
+  Histogram(Histogram const&) = delete;
+  ~Histogram() = default;
+  Histogram& operator=(Histogram&&) = delete;
+  Histogram& operator=(Histogram const&) = delete;
+  void add(Tick const val);
+  void clear();
+  std::size_t count() const;
+  Tick total() const;
+  Tick mean() const;
+  Tick max() const;
+  // upper bound of the bucket reaching the fraction of samples, 0.0 to 1.0
+  Tick percentile(double const val) const;
+
+private:
+  static constexpr std::size_t _sub {4};
+  // up to 2^42 ns, larger samples go in the last bucket
+  static constexpr std::size_t _size {42 * _sub};
+
+  static std::size_t index(std::uint64_t const val);
+  static std::uint64_t upper(std::size_t const idx);
+
+  std::array<std::atomic<std::size_t>, _size> _bucket {};
+  std::atomic<std::size_t> _count {0};
+  std::atomic<std::uint64_t> _total {0};
+  std::atomic<std::uint64_t> _max {0};
+}; // class Histogram
+
+// xoshiro256** seeded through splitmix64, a seed always replays the same draws
+class Random final {
+public:
+  Random() = default;
+  Random(Random&&) = default;
+  Random(Random const&) = default;
+  ~Random() = default;
+  Random& operator=(Random&&) = default;
+  Random& operator=(Random const&) = default;
+  void seed(std::uint64_t const seed);
+  std::uint64_t seed() const;
+  std::uint64_t next();
+  // uniform in [l, u] without modulo bias
+  std::size_t range(std::size_t const l, std::size_t const u);
+
+private:
+  std::uint64_t _seed {0};
+  std::array<std::uint64_t, 4> _state {};
+}; // class Random
+
+// time spent in a scene per tick
+struct Scene_perf {
+  Histogram update;
+  Histogram render;
+};
+
+// board cells covered by snakes, in board steps of 2 columns by 1 row
+class Grid final {
+public:
+  // cells per side of a chunk, a power of two
+  static constexpr std::size_t chunk_size {64};
+
+  Grid() = default;
+  Grid(Grid&&) = default;
+  Grid(Grid const&) = delete;
+  ~Grid() = default;
+  Grid& operator=(Grid&&) = default;
+  Grid& operator=(Grid const&) = delete;
+  // size in steps, clears every cell
+  void size(Size const& size);
+  Size size() const;
+  // positions use board columns, left or below the board wraps around and is outside
+  bool inside(Pos const& pos) const;
+  bool test(Pos const& pos) const;
+  void set(Pos const& pos);
+  void reset(Pos const& pos);
+  // number of covered cells
+  std::size_t count() const;
+  // every cell is covered
+  bool full() const;
+  // uniformly chosen empty cell, none when the board is full
+  std::optional<Pos> random(Random& rng) const;
+  // allocated chunks
+  std::size_t chunks() const;
+
+private:
+  struct Chunk {
+    // blocks on each cell, a snake without body collision can cover a cell twice
+    std::array<std::uint16_t, chunk_size * chunk_size> cell {};
+    // covered cells
+    std::size_t count {0};
+  };
+
+  // chunk row in the high half, chunk column in the low half
+  std::uint64_t key(Pos const& pos) const;
+  std::size_t slot(Pos const& pos) const;
+  Chunk* find(Pos const& pos) const;
+  std::unique_ptr<Chunk> take();
+  void give(std::unique_ptr<Chunk>&& val);
+
+  Size _size;
+  // only chunks with a covered cell are allocated, an empty board holds none
+  std::unordered_map<std::uint64_t, std::unique_ptr<Chunk>> _chunk;
+  // emptied chunks kept for reuse, a snake crossing a chunk edge does not allocate
+  std::vector<std::unique_ptr<Chunk>> _spare;
+  std::size_t _count {0};
+}; // class Grid
+
+// per row column range, end exclusive
+using Spans = std::vector<std::pair<std::size_t, std::size_t>>;
+
+// diffs a frame against the last one written and writes the changes to the terminal
+class Output final {
+public:
+  // updated once per frame, possibly from the output thread
+  struct Stats {
+    std::atomic<std::size_t> frames {0};
+    std::atomic<std::size_t> bytes {0};
+    std::atomic<std::size_t> syscalls {0};
+    // size and write calls of the last frame that changed the screen
+    std::atomic<std::size_t> frame_bytes {0};
+    std::atomic<std::size_t> frame_syscalls {0};
+    std::atomic<std::size_t> area {0};
+    std::atomic<std::size_t> sgr_hit {0};
+    std::atomic<std::size_t> sgr_miss {0};
+    std::atomic<std::size_t> sgr_saved {0};
+    // frames folded into the next one while the terminal was still taking the last
+    std::atomic<std::size_t> merged {0};
+    // times the terminal buffer was full
+    std::atomic<std::size_t> full {0};
+    // time spent in each stage of a frame
+    Histogram diff;
+    Histogram encode;
+    Histogram write;
+  };
+
+  Output();
+  Output(Output&&) = delete;
+  Output(Output const&) = delete;
+  ~Output();
+  Output& operator=(Output&&) = delete;
+  Output& operator=(Output const&) = delete;
+  void size(Size const& size);
+  // only the cells within span are compared against prev
+  void frame(Buffer& buf, Buffer& prev, Spans const& span);
+  // wrap frames in the synchronized update markers, terminals without support ignore them
+  void sync(bool const val);
+  bool sync();
+  // colour depth of the terminal, the next frame is redrawn in full when it changes
+  void depth(std::uint8_t const type);
+  std::uint8_t depth();
+  // file descriptor frames are written to, a negative value discards them,
+  // any other than stdout is owned and closed with the output
+  void sink(int const fd);
+  // wait for a full terminal through the io_context instead of blocking,
+  // on_flush is called once the rest of the frame is written
+  void async(Belle::asio::io_context& io, std::function<void()> on_flush);
+  // the terminal has not taken all of the last frame yet
+  bool busy();
+  // write the rest of the last frame, blocking
+  void flush();
+  Stats& stats();
+
+private:
+  // a full terminal either blocks or leaves the rest pending on the io_context
+  std::size_t write(bool const wait);
+  void await_write();
+
+  Size _size;
+  Encoder _enc;
+  std::vector<Pos> _dirty;
+  // fraction of changed cells above which a frame is redrawn in full
+  double _redraw_ratio {0.5};
+  std::atomic<bool> _sync {false};
+  std::atomic<std::uint8_t> _depth {Style::Bit_24};
+  int _fd {STDOUT_FILENO};
+  // bytes of the encoded frame already written
+  std::size_t _offset {0};
+  std::optional<Belle::asio::posix::stream_descriptor> _stream;
+  bool _waiting {false};
+  std::function<void()> _on_flush;
+  OB::Timer<std::chrono::steady_clock> _timer;
+  Stats _stats;
+}; // class Output
+
 class Engine;
 
 using Ctx = Engine*;
 
 class Scene {
 public:
-  Scene(Ctx ctx) : _ctx {ctx} {}
+  Scene(Ctx ctx, int const zidx = 0) : _ctx {ctx}, _zidx {zidx} {}
   Scene(Scene&&) = default;
   Scene(Scene const&) = default;
   virtual ~Scene() = default;
@@ -204,8 +530,12 @@ public:
   virtual bool on_input(Read::Ctx const& ctx) = 0;
   virtual bool on_update(Tick const delta) = 0;
   virtual bool on_render(Buffer& buf) = 0;
+  // time until the scene changes without input, max when it only changes on input
+  virtual Tick deadline() {return Tick::max();}
 
   Ctx _ctx;
+  // compositor layer, cells of higher layers cover lower ones
+  int _zidx;
   Pos _pos;
   Size _size;
 }; // class Scene
@@ -226,7 +556,7 @@ public:
   bool on_render(Buffer& buf);
 
 // private:
-  Cell _cell {this, 0, Style{Style::Bit_24, Style::Null, Color{}, hex_to_rgb("031323")}, " "};
+  Cell _cell {this, 0, Style{Style::Bit_24, Style::Null, Color{}, hex_to_rgb("031323")}, Glyph(" ")};
 }; // class Background
 
 class Board : public Scene {
@@ -241,11 +571,21 @@ public:
   bool on_input(Read::Ctx const& ctx);
   bool on_update(Tick const delta);
   bool on_render(Buffer& buf);
+  // sized again to the screen on the next winch
+  void reset();
+  // the block is inside the view
+  bool visible(Pos const& pos) const;
+  // moves the view to keep pos away from its edges, true when it moved
+  bool follow(Pos const& pos);
 
 // private:
   Style _style {Style::Bit_24, Style::Null, hex_to_rgb("0b253d"), hex_to_rgb("031323")};
   Style _block1 {Style::Bit_24, Style::Null, Color(), hex_to_rgb("031323")};
   Style _block2 {Style::Bit_24, Style::Null, Color(), hex_to_rgb("0b253d")};
+  // cells inside the border, a board set with '--world' can be larger than them
+  Size _view;
+  // board position of the bottom left cell in view
+  Pos _camera;
   bool _init {true};
 }; // class Board
 
@@ -261,6 +601,9 @@ public:
   bool on_input(Read::Ctx const& ctx);
   bool on_update(Tick const delta);
   bool on_render(Buffer& buf);
+  Tick deadline();
+  // back to the start of a game, keeping the bindings and allocated storage
+  void reset();
 
 // private:
 
@@ -284,7 +627,18 @@ public:
     std::string_view value;
   };
 
-  std::deque<Block> _sprite;
+  // sized to the board, moving never allocates
+  OB::Ring<Block> _sprite;
+
+  // what is on screen since the last render
+  struct {
+    // vacated blocks
+    std::vector<Pos> erase;
+    // blocks added at the front
+    std::size_t moved {0};
+    Pos head;
+    int special {0};
+  } _drawn;
 
   bool _init {true};
   enum Dir {Up, Down, Left, Right};
@@ -310,7 +664,7 @@ public:
   OB::Color _color;
 
   std::size_t _state_eyes_idx {0};
-  std::vector<std::pair<std::function<void(Cell&)>, Tick>> _state_eyes {{[](Cell&) {}, 3000ms}, {[](Cell& cell) {cell.style.attr = Style::Null;}, 100ms}, {[](Cell& cell) {cell.text = " ";}, 50ms}, {[](Cell& cell) {cell.style.attr = Style::Null;}, 100ms}};
+  std::vector<std::pair<std::function<void(Cell&)>, Tick>> _state_eyes {{[](Cell&) {}, 3000ms}, {[](Cell& cell) {cell.style.attr = Style::Null;}, 100ms}, {[](Cell& cell) {cell.text = Glyph(" ");}, 50ms}, {[](Cell& cell) {cell.style.attr = Style::Null;}, 100ms}};
   Tick _blink_delta {0ms};
   Tick _blink_interval {3000ms};
 
@@ -333,6 +687,9 @@ public:
   bool on_input(Read::Ctx const& ctx);
   bool on_update(Tick const delta);
   bool on_render(Buffer& buf);
+  Tick deadline();
+  // back to the centre of the board on the next winch
+  void reset();
 
 // private:
 
@@ -353,10 +710,62 @@ public:
   Tick _interval {0ms};
   Tick _duration {2000ms};
   std::size_t count {0};
+  // placed at random on the board instead of at its centre
+  bool _random {false};
+  // no empty cell was left to spawn on, hidden until one frees up
+  bool _full {false};
 
-  void spawn();
+  bool spawn();
+  // the normal colour at the start of its pulse
+  void style_normal();
 }; // class Egg
 
+class Bot : public Scene {
+public:
+  // how the next step towards the nearest egg is found
+  enum Ai {Greedy, Bfs};
+
+  Bot(Ctx ctx, std::size_t const idx, Ai const ai);
+  Bot(Bot&&) = default;
+  Bot(Bot const&) = default;
+  ~Bot();
+  Bot& operator=(Bot&&) = default;
+  Bot& operator=(Bot const&) = default;
+  void on_winch(Size const& size);
+  bool on_input(Read::Ctx const& ctx);
+  bool on_update(Tick const delta);
+  bool on_render(Buffer& buf);
+  Tick deadline();
+
+// private:
+  Ai _ai;
+  struct {
+    Style head {Style::Bit_24, Style::Null, Color(), Color()};
+    Style body {Style::Bit_24, Style::Null, Color(), Color()};
+  } _style;
+  std::string _text {"  "};
+  std::deque<Pos> _body;
+  std::size_t _ext {2};
+  bool _init {true};
+  Tick _delta {0ms};
+  Tick _interval {100ms};
+
+  // what is on screen since the last render
+  struct {
+    std::vector<Pos> erase;
+    std::size_t moved {0};
+  } _drawn;
+
+  // scratch space of the path search, shared as the bots step one at a time
+  static inline std::vector<std::size_t> _prev;
+  static inline std::vector<std::size_t> _queue;
+
+  void step();
+  std::optional<Pos> greedy(Pos const& head, Pos const& egg);
+  std::optional<Pos> bfs(Pos const& head);
+  void respawn();
+}; // class Bot
+
 class Prompt : public Scene {
 public:
   Prompt(Ctx ctx);
@@ -369,6 +778,7 @@ public:
   bool on_input(Read::Ctx const& ctx);
   bool on_update(Tick const delta);
   bool on_render(Buffer& buf);
+  Tick deadline();
 
 // private:
   Readline _readline;
@@ -400,6 +810,7 @@ public:
   bool on_input(Read::Ctx const& ctx);
   bool on_update(Tick const delta);
   bool on_render(Buffer& buf);
+  Tick deadline();
 
 // private:
   struct {
@@ -428,8 +839,42 @@ public:
   void widget_dir();
 }; // class Status
 
+// tick timings drawn over the game, toggled with '(perf-overlay n)'
+class Perf : public Scene {
+public:
+  Perf(Ctx ctx);
+  Perf(Perf&&) = default;
+  Perf(Perf const&) = default;
+  ~Perf();
+  Perf& operator=(Perf&&) = default;
+  Perf& operator=(Perf const&) = default;
+  void on_winch(Size const& size);
+  bool on_input(Read::Ctx const& ctx);
+  bool on_update(Tick const delta);
+  bool on_render(Buffer& buf);
+  Tick deadline();
+
+// private:
+  struct {
+    Style text {Style::Bit_24, Style::Null, hex_to_rgb("b140a2"), hex_to_rgb("0b253d")};
+    Style name {Style::Bit_24, Style::Bold, hex_to_rgb("8242cf"), hex_to_rgb("0b253d")};
+    Style graph {Style::Bit_24, Style::Null, hex_to_rgb("c8c213"), hex_to_rgb("0b253d")};
+  } _style;
+  bool _enabled {false};
+  Tick _delta {0ms};
+  Tick _interval {250ms};
+  std::vector<std::string> _lines;
+  std::string _graph;
+  std::size_t _width {42};
+
+  void refresh();
+}; // class Perf
+
 class Root : public Scene {
 public:
+  // compositor layers by z-index
+  enum Layer : int {Static = 0, Game, Item, Ui, Overlay};
+
   Root(Ctx ctx);
   Root(Root&&) = default;
   Root(Root const&) = default;
@@ -440,14 +885,69 @@ public:
   bool on_input(Read::Ctx const& ctx);
   bool on_update(Tick const delta);
   bool on_render(Buffer& buf);
+  Tick deadline();
 
   bool on_read(Read::Null const& ctx);
   bool on_read(Read::Mouse const& ctx);
   bool on_read(Read::Key const& ctx);
+  // resolve the typed scene handles and the update and render order
+  void index();
+  // redraw every layer next frame, retained layers only draw what changed
+  void dirty();
+  void dirty(int const zidx);
+  // put back the static cell under a cell of the lowest layer
+  void erase(Buffer& buf, Pos const& pos, int const zidx);
+  // a snake or bot covers the board position
+  bool occupied(Pos const& pos);
+  // keep the player in view, a moved view draws the static layer again
+  void follow(Pos const& pos);
+  // put the snakes and eggs back after a restart
+  void restart();
+  // digest of the snakes and eggs, two runs that agree on it every tick played out the same
+  std::uint32_t hash() const;
 
 // private:
+  // a scene with its timings, kept in the order the scenes run
+  struct Target {
+    Scene* scene;
+    Scene_perf* perf;
+  };
+
+  struct Surface {
+    // scenes drawn on the layer in order
+    std::vector<Target> scenes;
+    // regions written since the layer was last drawn in full
+    std::vector<Rect> damage;
+    bool dirty {true};
+    // cells were put back, the layer has to be drawn in full
+    bool full {true};
+    // cells are kept between frames, its scenes erase what they vacate
+    bool retained {false};
+  };
+
+  // static layer, only drawn on resize
   Buffer _buf;
+  std::array<Surface, Overlay + 1> _layers;
+  // per cell bit set of the layers that wrote it
+  std::vector<std::uint8_t> _cover;
+  // regions of the layers below while one layer is drawn
+  std::vector<Rect> _damage;
   Scenes _scenes;
+  // typed handles to the named scenes, only valid until _scenes changes and index() runs again
+  struct {
+    Board* board {nullptr};
+    Snake* snake {nullptr};
+    Egg* egg {nullptr};
+    Prompt* prompt {nullptr};
+  } _scene;
+  // every scene in update order
+  std::vector<Target> _targets;
+  // stress mode snakes and the eggs they share with the player besides "egg"
+  std::vector<std::shared_ptr<Bot>> _bots;
+  std::vector<std::shared_ptr<Egg>> _eggs;
+  // sized by the board, kept up to date by the snakes as they move
+  Grid _grid;
+  OB::Timer<std::chrono::steady_clock> _timer;
   bool _dirty {true};
   std::string _focus;
   std::unordered_map<char32_t, Xpr> _input;
@@ -466,7 +966,25 @@ public:
   Engine& operator=(Engine const&) = delete;
   void run();
 
-  std::shared_ptr<Scene> _root;
+  // tick stage timings, read with '(perf)'
+  struct {
+    Histogram tick;
+    Histogram input;
+    Histogram update;
+    Histogram render;
+    // time to put the game back to its start with 'r' or 'R'
+    Histogram restart;
+    std::map<std::string, Scene_perf, std::less<>> scenes;
+    // most recent tick times, oldest first from idx
+    std::array<Tick, 64> recent {};
+    std::size_t idx {0};
+  } _perf;
+
+  std::shared_ptr<Root> _root;
+  // every random choice of the game, seeded with '--seed' or '(seed n)'
+  Random _random;
+  // board size in steps set with '--world', zero fits the board to the screen
+  Size _world;
   Tick _time {0ms};
   std::size_t _frames {0};
   int _fps_actual {0};
@@ -484,16 +1002,27 @@ public:
   void await_read();
   void await_tick();
   void on_tick();
+  void wake();
   bool on_read(Read::Null& ctx);
   bool on_read(Read::Mouse& ctx);
   bool on_read(Read::Key& ctx);
-  void write();
+  void input(Read::Ctx const& ctx);
+  void record(Read::Ctx const& ctx);
+  void record_start();
+  void record_tick();
+  void record_stop();
+  void replay(fs::path const& path);
+  void script(fs::path const& path);
+  void report();
+  void writer_start();
+  void writer_stop();
+  void writer_run();
 
   OB::Parg& _pg;
   Belle::asio::io_context _io {1};
   Belle::Signal _sig {_io};
   Read _read {_io};
-  Term::Mode _term_mode;
+  std::optional<Term::Mode> _term_mode;
   Size _size;
   OB::Timer<std::chrono::steady_clock> _tick_timer;
   std::chrono::time_point<Clock> _tick_begin {(Clock::time_point::min)()};
@@ -501,13 +1030,119 @@ public:
   int _fps {30};
   Tick _tick {static_cast<Tick>(1000000000 / _fps)};
   Timer _timer {_io};
+
+  // ticks fire on a fixed grid of absolute deadlines so waits do not drift
+  struct {
+    // what to do with ticks missed while a tick ran long
+    enum Policy {Skip, Burst};
+    Policy policy {Skip};
+    // missed ticks run back to back with a fixed step, beyond this they are skipped
+    std::size_t burst {4};
+    // deadline of the last tick run and of the pending one
+    std::chrono::time_point<Clock> last;
+    std::chrono::time_point<Clock> next;
+    // how late each tick woke, and how far its spacing was from the schedule
+    Histogram latency;
+    Histogram jitter;
+  } _sched;
   std::unordered_map<char32_t, Xpr> _input;
+  // input queued by tick from '(input)'
+  std::multimap<std::size_t, Read::Ctx> _input_queue;
+
+  // run without a terminal, enabled with '--headless'
+  struct {
+    bool enabled {false};
+    // wait for each tick instead of running as fast as possible
+    bool paced {true};
+    Size size {120, 40};
+    std::size_t frames {1000};
+    std::vector<Tick> ticks;
+    std::chrono::time_point<Clock> begin;
+  } _headless;
+
+  // computer controlled snakes loading the game, enabled with '--stress'
+  struct {
+    std::size_t bots {0};
+    Bot::Ai ai {Bot::Greedy};
+  } _stress;
+
+  // entries of a recorded run, each starts with a varint of the ticks since the last entry shifted over the kind
+  enum Entry : std::uint8_t {Key_entry, Mouse_entry, Null_entry, Hash_entry, End_entry};
+
+  // input events and a state hash per tick written to a file, enabled with '--record'
+  struct {
+    bool enabled {false};
+    fs::path path;
+    std::ofstream file;
+    // tick of the last entry written
+    std::size_t tick {0};
+    // encoded entry before it is written
+    std::string buf;
+  } _record;
+
+  // input events fed back from a recorded run, enabled with '--replay'
+  struct {
+    bool enabled {false};
+    Size size;
+    // length of the recorded run in ticks
+    std::size_t ticks {0};
+    // recorded state hash of each tick
+    std::vector<std::uint32_t> hash;
+    // first tick whose state differs from the recording
+    std::optional<std::size_t> desync;
+  } _replay;
 
-  std::size_t _bsize {0};
   Buffer _buf;
   Buffer _buf_prev;
-  Style _style;
-  std::string _line;
+  Output _out;
+  bool _redraw {true};
+  // changed outside of on_update, render the next tick
+  bool _dirty {true};
+  // a rendered frame has not reached the output yet
+  bool _pending {false};
+  // per row column range written in the current frame
+  Spans _span;
+  // per row column range changed since the last frame handed to the output
+  Spans _span_out;
+  std::size_t _damage_regions {0};
+
+  // ticks with nothing changed skip rendering and sleep until the next scene deadline
+  struct {
+    // the pending wait spans more than one tick, input cuts it short
+    bool sleep {false};
+    // the tick follows a sleep, the gap is not counted as dropped frames
+    bool slept {false};
+    // ticks that skipped rendering
+    std::size_t ticks {0};
+    std::size_t sleeps {0};
+  } _idle;
+
+  // snapshot of a rendered frame for the output thread
+  struct Frame {
+    Buffer buf;
+    Spans span;
+    bool redraw {false};
+  };
+
+  // optional thread writing frames to the terminal, enabled with '--output-thread'
+  struct {
+    bool enabled {false};
+    std::thread thread;
+    OB::Spsc<Frame> queue {4};
+    // only used to sleep while the queue is empty
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool stop {false};
+    // frames not queued because the queue was full
+    std::size_t dropped {0};
+    // queued frames skipped in favour of a newer one
+    std::atomic<std::size_t> coalesced {0};
+    std::atomic<bool> failed {false};
+    std::exception_ptr error;
+    // output thread state, the last frame written and the range to diff
+    Buffer prev;
+    Spans span;
+  } _writer;
 }; // class Engine
 
 }; // namespace Nyble
@@ -119,6 +119,18 @@ inline void program_init(OB::Parg& pg)
   pg.info({"Examples", {
     {"nyble",
       "run the program"},
+    {"nyble --headless --fps=0 --frames=2000 --script=bench.nlx",
+      "run 2000 frames headless as fast as possible with scripted input"},
+    {"nyble --headless --fps=0 --stress=200 --stress-ai=bfs",
+      "run 1000 frames headless with 200 path finding snakes on the board"},
+    {"nyble --headless --fps=0 --stress=50 --seed=42",
+      "run 1000 frames headless, the same on every run"},
+    {"nyble --world=10000x10000 --stress=2000",
+      "play on a board far larger than the screen shared with 2000 snakes"},
+    {"nyble --record=run.rec",
+      "play and write the input of the run to 'run.rec'"},
+    {"nyble --headless --fps=0 --replay=run.rec",
+      "replay 'run.rec' as fast as possible and check it plays out the same"},
     {"nyble --help --colour=off",
       "print the help output, without colour"},
     {"nyble --help",
@@ -155,6 +167,22 @@ inline void program_init(OB::Parg& pg)
 
   // options
   pg.set("colour", "auto", "on|off|auto", "Print the program output with colour either on, off, or auto based on if stdout is a tty, the default value is 'auto'.");
+  pg.set("catch-up", "skip", "skip|burst", "What to do with ticks missed while the game runs late, either skip them or run them back to back with a fixed step, the default value is 'skip'.");
+  pg.set("colour-depth", "24", "24|8|4|2", "Colour depth of the terminal in bits, colours are quantized to the 256 or 16 colour palette, or dropped with '2', the default value is '24'.");
+  pg.set("fps", "30", "n", "Number of frames per second, the default value is '30'. With '--headless' a value of '0' runs as fast as possible.");
+  pg.set("headless", "Run the game without a terminal and print frame timings on exit, see '--size', '--frames', '--sink', and '--script'.");
+  pg.set("size", "120x40", "WxH", "Screen size used with '--headless', the default value is '120x40'.");
+  pg.set("frames", "1000", "n", "Number of frames to run with '--headless', the default value is '1000'.");
+  pg.set("sink", "memory", "memory|null", "Where '--headless' writes frames, either discarded in memory or written to '/dev/null', the default value is 'memory'.");
+  pg.set("script", "", "file", "Evaluate a nyblisp file at startup, one expression per line. Use '(input tick str)' to queue key presses.");
+  pg.set("record", "", "file", "Write the input events and a state hash of every tick to a compact binary file for '--replay'.");
+  pg.set("replay", "", "file", "Play back a file written with '--record' at its screen size, board size, seed, and tick rate, exiting with an error if the game state drifts from the recording. Pass the same '--script', its '(input)' keys are taken from the recording. With '--headless --fps=0' it runs as fast as possible.");
+  pg.set("seed", "", "n", "Seed of the random number generator, the same seed and input replay the same game, the default is a new seed every run.");
+  pg.set("stress", "0", "n", "Number of computer controlled snakes sharing the board and a pool of eggs with the player, the default value is '0'.");
+  pg.set("stress-ai", "greedy", "greedy|bfs", "How '--stress' snakes head for the nearest egg, either a greedy step towards it or a shortest path around every snake, the default value is 'greedy'.");
+  pg.set("world", "", "WxH", "Size of the board in cells, it can be far larger than the screen with the view following the player, the default fits the board to the screen.");
+  pg.set("sync", "Wrap each frame in the synchronized update escape sequences so the terminal presents it at once, terminals without support ignore them.");
+  pg.set("output-thread", "Write frames to the terminal from a separate thread, skipping frames while the terminal falls behind.");
 
   // allow and capture positional arguments
   // pg.set_pos();
@@ -317,6 +317,7 @@ void Env::list(Xpr& x) {
 std::shared_ptr<Env> Fun::bind(Sym const& sym, Lst& l, std::shared_ptr<Env> e) {
   if (args.empty() && l.size()) {throw std::runtime_error("'" + sym + "' expected '0' arguments");}
   auto const has_rest {[this]() {
+    if (args.empty()) {return false;}
     if (auto const s = xpr_sym(&args.back()); s && *s == "@") {
       return true;
     }
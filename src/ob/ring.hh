@@ -0,0 +1,298 @@
+/*
+                                    88888888
+                                  888888888888
+                                 88888888888888
+                                8888888888888888
+                               888888888888888888
+                              888888  8888  888888
+                              88888    88    88888
+                              888888  8888  888888
+                              88888888888888888888
+                              88888888888888888888
+                             8888888888888888888888
+                          8888888888888888888888888888
+                        88888888888888888888888888888888
+                              88888888888888888888
+                            888888888888888888888888
+                           888888  8888888888  888888
+                           888     8888  8888     888
+                                   888    888
+
+                                   OCTOBANANA
+
+Licensed under the MIT License
+
+Copyright (c) 2018-2019 Brett Robinson <https://octobanana.com/>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef OB_RING_HH
+#define OB_RING_HH
+
+#include <cstddef>
+
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <stdexcept>
+#include <algorithm>
+#include <type_traits>
+
+namespace OB
+{
+
+// Ring: a double ended queue over one contiguous buffer
+// slots are allocated up front by reserve() and reused as elements are
+// pushed and popped at either end, the buffer only grows when pushing
+// onto a full ring, iterators are random access from front to back
+template<typename T>
+class Ring final
+{
+public:
+
+  using value_type = T;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = T&;
+  using const_reference = T const&;
+
+  template<bool C>
+  class Iter final
+  {
+  public:
+
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<C, T const*, T*>;
+    using reference = std::conditional_t<C, T const&, T&>;
+    using ring_type = std::conditional_t<C, Ring const, Ring>;
+
+    Iter() = default;
+
+    Iter(ring_type* ring, size_type const idx) :
+      _ring {ring},
+      _idx {idx}
+    {
+    }
+
+    // iterator converts to const_iterator
+    operator Iter<true>() const
+    {
+      return Iter<true>(_ring, _idx);
+    }
+
+    reference operator*() const {return (*_ring)[_idx];}
+    pointer operator->() const {return &(*_ring)[_idx];}
+    reference operator[](difference_type const n) const {return (*_ring)[_idx + static_cast<size_type>(n)];}
+
+    Iter& operator++() {++_idx; return *this;}
+    Iter& operator--() {--_idx; return *this;}
+    Iter operator++(int) {auto res = *this; ++_idx; return res;}
+    Iter operator--(int) {auto res = *this; --_idx; return res;}
+    Iter& operator+=(difference_type const n) {_idx += static_cast<size_type>(n); return *this;}
+    Iter& operator-=(difference_type const n) {_idx -= static_cast<size_type>(n); return *this;}
+    Iter operator+(difference_type const n) const {return Iter(_ring, _idx + static_cast<size_type>(n));}
+    Iter operator-(difference_type const n) const {return Iter(_ring, _idx - static_cast<size_type>(n));}
+    friend Iter operator+(difference_type const n, Iter const& it) {return it + n;}
+    difference_type operator-(Iter const& rhs) const {return static_cast<difference_type>(_idx) - static_cast<difference_type>(rhs._idx);}
+
+    bool operator==(Iter const& rhs) const {return _idx == rhs._idx;}
+    bool operator!=(Iter const& rhs) const {return _idx != rhs._idx;}
+    bool operator<(Iter const& rhs) const {return _idx < rhs._idx;}
+    bool operator>(Iter const& rhs) const {return _idx > rhs._idx;}
+    bool operator<=(Iter const& rhs) const {return _idx <= rhs._idx;}
+    bool operator>=(Iter const& rhs) const {return _idx >= rhs._idx;}
+
+  private:
+
+    ring_type* _ring {nullptr};
+    // position from the front
+    size_type _idx {0};
+  }; // class Iter
+
+  using iterator = Iter<false>;
+  using const_iterator = Iter<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  Ring() = default;
+  Ring(Ring&&) = default;
+  Ring(Ring const&) = default;
+  ~Ring() = default;
+  Ring& operator=(Ring&&) = default;
+  Ring& operator=(Ring const&) = default;
+
+  // allocate room for at least n elements, keeps the elements in order
+  void reserve(size_type const n)
+  {
+    if (n <= _value.size())
+    {
+      return;
+    }
+
+    std::vector<T> value;
+    value.reserve(n);
+
+    for (auto& e : *this)
+    {
+      value.emplace_back(std::move(e));
+    }
+
+    value.resize(n);
+    _value = std::move(value);
+    _head = 0;
+  }
+
+  size_type capacity() const
+  {
+    return _value.size();
+  }
+
+  size_type size() const
+  {
+    return _size;
+  }
+
+  bool empty() const
+  {
+    return _size == 0;
+  }
+
+  void clear()
+  {
+    _head = 0;
+    _size = 0;
+  }
+
+  T& operator[](size_type const idx)
+  {
+    return _value[slot(idx)];
+  }
+
+  T const& operator[](size_type const idx) const
+  {
+    return _value[slot(idx)];
+  }
+
+  T& at(size_type const idx)
+  {
+    if (idx >= _size)
+    {
+      throw std::out_of_range("Ring::at");
+    }
+
+    return (*this)[idx];
+  }
+
+  T const& at(size_type const idx) const
+  {
+    if (idx >= _size)
+    {
+      throw std::out_of_range("Ring::at");
+    }
+
+    return (*this)[idx];
+  }
+
+  T& front() {return (*this)[0];}
+  T const& front() const {return (*this)[0];}
+  T& back() {return (*this)[_size - 1];}
+  T const& back() const {return (*this)[_size - 1];}
+
+  template<typename... Args>
+  T& emplace_front(Args&&... args)
+  {
+    grow();
+    _head = _head ? _head - 1 : _value.size() - 1;
+    ++_size;
+
+    return front() = T{std::forward<Args>(args)...};
+  }
+
+  template<typename... Args>
+  T& emplace_back(Args&&... args)
+  {
+    grow();
+    ++_size;
+
+    return back() = T{std::forward<Args>(args)...};
+  }
+
+  void pop_front()
+  {
+    _head = slot(1);
+    --_size;
+  }
+
+  void pop_back()
+  {
+    --_size;
+  }
+
+  // the freed slots keep their old values until they are reused
+  iterator erase(const_iterator first, const_iterator last)
+  {
+    auto const from = first - cbegin();
+    auto const to = last - cbegin();
+    std::move(begin() + to, end(), begin() + from);
+    _size -= static_cast<size_type>(to - from);
+
+    return begin() + from;
+  }
+
+  iterator begin() {return iterator(this, 0);}
+  iterator end() {return iterator(this, _size);}
+  const_iterator begin() const {return const_iterator(this, 0);}
+  const_iterator end() const {return const_iterator(this, _size);}
+  const_iterator cbegin() const {return begin();}
+  const_iterator cend() const {return end();}
+  reverse_iterator rbegin() {return reverse_iterator(end());}
+  reverse_iterator rend() {return reverse_iterator(begin());}
+  const_reverse_iterator rbegin() const {return const_reverse_iterator(end());}
+  const_reverse_iterator rend() const {return const_reverse_iterator(begin());}
+
+private:
+
+  size_type slot(size_type const idx) const
+  {
+    auto const pos = _head + idx;
+
+    return pos >= _value.size() ? pos - _value.size() : pos;
+  }
+
+  // a full ring doubles in size
+  void grow()
+  {
+    if (_size == _value.size())
+    {
+      reserve(std::max<size_type>(16, _value.size() * 2));
+    }
+  }
+
+  std::vector<T> _value;
+  // slot of the front element
+  size_type _head {0};
+  size_type _size {0};
+}; // class Ring
+
+} // namespace OB
+
+#endif // OB_RING_HH
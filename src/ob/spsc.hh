@@ -0,0 +1,153 @@
+/*
+                                    88888888
+                                  888888888888
+                                 88888888888888
+                                8888888888888888
+                               888888888888888888
+                              888888  8888  888888
+                              88888    88    88888
+                              888888  8888  888888
+                              88888888888888888888
+                              88888888888888888888
+                             8888888888888888888888
+                          8888888888888888888888888888
+                        88888888888888888888888888888888
+                              88888888888888888888
+                            888888888888888888888888
+                           888888  8888888888  888888
+                           888     8888  8888     888
+                                   888    888
+
+                                   OCTOBANANA
+
+Licensed under the MIT License
+
+Copyright (c) 2018-2019 Brett Robinson <https://octobanana.com/>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef OB_SPSC_HH
+#define OB_SPSC_HH
+
+#include <cstddef>
+
+#include <atomic>
+#include <vector>
+#include <utility>
+
+namespace OB
+{
+
+// Spsc: a bounded single producer single consumer lock-free queue
+// slots are allocated once and reused, the producer fills the slot returned
+// by back() in place and publishes it with push(), the consumer reads the
+// slot returned by front() in place and releases it with pop()
+template<typename T>
+class Spsc final
+{
+public:
+
+  using size_type = std::size_t;
+
+  explicit Spsc(size_type const capacity) :
+    _value(capacity + 1)
+  {
+  }
+
+  Spsc(Spsc&&) = delete;
+  Spsc(Spsc const&) = delete;
+  ~Spsc() = default;
+  Spsc& operator=(Spsc&&) = delete;
+  Spsc& operator=(Spsc const&) = delete;
+
+  // producer: next free slot, or nullptr when the queue is full
+  T* back()
+  {
+    auto const tail = _tail.load(std::memory_order_relaxed);
+
+    if (next(tail) == _head.load(std::memory_order_acquire))
+    {
+      return nullptr;
+    }
+
+    return &_value[tail];
+  }
+
+  // producer: publish the slot returned by back()
+  void push()
+  {
+    _tail.store(next(_tail.load(std::memory_order_relaxed)), std::memory_order_release);
+  }
+
+  // consumer: oldest published slot, or nullptr when the queue is empty
+  T* front()
+  {
+    auto const head = _head.load(std::memory_order_relaxed);
+
+    if (head == _tail.load(std::memory_order_acquire))
+    {
+      return nullptr;
+    }
+
+    return &_value[head];
+  }
+
+  // consumer: release the slot returned by front()
+  void pop()
+  {
+    _head.store(next(_head.load(std::memory_order_relaxed)), std::memory_order_release);
+  }
+
+  // number of published slots, exact only when called from either end
+  size_type size() const
+  {
+    auto const head = _head.load(std::memory_order_acquire);
+    auto const tail = _tail.load(std::memory_order_acquire);
+
+    return tail >= head ? tail - head : tail + _value.size() - head;
+  }
+
+  size_type capacity() const
+  {
+    return _value.size() - 1;
+  }
+
+  bool empty() const
+  {
+    return size() == 0;
+  }
+
+private:
+
+  size_type next(size_type const pos) const
+  {
+    return pos + 1 == _value.size() ? 0 : pos + 1;
+  }
+
+  std::vector<T> _value;
+
+  // keep the indices on separate cache lines
+  alignas(64) std::atomic<size_type> _head {0};
+  alignas(64) std::atomic<size_type> _tail {0};
+}; // class Spsc
+
+} // namespace OB
+
+#endif // OB_SPSC_HH
@@ -174,80 +174,50 @@ public:
       return *this;
     }
 
-    UErrorCode ec = U_ZERO_ERROR;
-
-    std::unique_ptr<UText, decltype(&utext_close)> text (
-      utext_openUTF8(nullptr, str.data(), static_cast<std::int64_t>(str.size()), &ec),
-      utext_close);
-
-    if (U_FAILURE(ec))
+    // pure ascii splits into one column graphemes without icu
+    if (std::all_of(str.begin(), str.end(), [](auto const ch) {return (static_cast<unsigned char>(ch) & 0x80) == 0;}))
     {
-      throw std::runtime_error("failed to create utext");
-    }
+      _view.reserve(str.size());
 
-    std::unique_ptr<brk_iter> iter {brk_iter::createCharacterInstance(
-      locale::getDefault(), ec)};
+      for (size_type i = 0; i < str.size();)
+      {
+        // carriage return and line feed form a single grapheme
+        size_type const size {str[i] == '\r' && i + 1 < str.size() && str[i + 1] == '\n' ? 2u : 1u};
+        push(str, size, 1);
+        i += size;
+      }
 
-    if (U_FAILURE(ec))
-    {
-      throw std::runtime_error("failed to create break iterator");
+      return *this;
     }
 
-    iter->setText(text.get(), ec);
-
-    if (U_FAILURE(ec))
+    if (str.size() > cache_bytes)
     {
-      throw std::runtime_error("failed to set break iterator text");
-    }
+      segment(str);
 
-    // get size of iterator
-    size_type size {0};
-    while (iter->next() != iter_end)
-    {
-      ++size;
+      return *this;
     }
 
-    // reserve array size
-    _view.reserve(size);
+    auto& entry = cache().at(std::hash<string_view>{}(str) % cache_size);
 
-    size = 0;
-    UChar32 uch;
-    int width {0};
-    size_type cols {0};
-    auto begin = iter->first();
-    auto end = iter->next();
-
-    while (end != iter_end)
+    if (entry.str != str)
     {
-      // get column width
-      uch = utext_char32At(text.get(), begin);
-      width = u_getIntPropertyValue(uch, UCHAR_EAST_ASIAN_WIDTH);
-      if (width == U_EA_FULLWIDTH || width == U_EA_WIDE)
-      {
-        // full width
-        cols = 2;
-      }
-      else
+      segment(str);
+      entry.str = str;
+      entry.seg.clear();
+
+      for (auto const& ctx : _view)
       {
-        // half width
-        cols = 1;
+        entry.seg.emplace_back(ctx.str.size(), ctx.cols);
       }
 
-      // get string size
-      size = static_cast<size_type>(end - begin);
-
-      // add character context to array
-      _view.emplace_back(_bytes, _cols, cols, string_view(str.data() + (_bytes * sizeof(char_type)), size));
-
-      // increase total column count
-      _cols += cols;
+      return *this;
+    }
 
-      // increase total byte count
-      _bytes += size;
+    _view.reserve(entry.seg.size());
 
-      // increase iterators
-      begin = end;
-      end = iter->next();
+    for (auto const& [size, cols] : entry.seg)
+    {
+      push(str, size, cols);
     }
 
     return *this;
@@ -693,6 +663,110 @@ public:
 
 private:
 
+  // previously segmented string with the byte size and column width of each grapheme
+  struct Entry
+  {
+    string str;
+    std::vector<std::pair<size_type, size_type>> seg;
+  }; // struct Entry
+
+  // number of cache entries, indexed by string hash
+  static size_type constexpr cache_size {256};
+
+  // strings longer than this are segmented without being cached
+  static size_type constexpr cache_bytes {64};
+
+  static std::array<Entry, cache_size>& cache()
+  {
+    thread_local std::array<Entry, cache_size> cache;
+
+    return cache;
+  }
+
+  // creating a break iterator is expensive, keep one per thread and reset its text
+  static brk_iter& iter()
+  {
+    thread_local std::unique_ptr<brk_iter> iter {[] {
+      UErrorCode ec = U_ZERO_ERROR;
+
+      std::unique_ptr<brk_iter> res {brk_iter::createCharacterInstance(
+        locale::getDefault(), ec)};
+
+      if (U_FAILURE(ec))
+      {
+        throw std::runtime_error("failed to create break iterator");
+      }
+
+      return res;
+    }()};
+
+    return *iter;
+  }
+
+  void push(string_view str, size_type size, size_type cols)
+  {
+    // add character context to array
+    _view.emplace_back(_bytes, _cols, cols, string_view(str.data() + (_bytes * sizeof(char_type)), size));
+
+    // increase total column count
+    _cols += cols;
+
+    // increase total byte count
+    _bytes += size;
+  }
+
+  void segment(string_view str)
+  {
+    UErrorCode ec = U_ZERO_ERROR;
+
+    UText text = UTEXT_INITIALIZER;
+    utext_openUTF8(&text, str.data(), static_cast<std::int64_t>(str.size()), &ec);
+
+    if (U_FAILURE(ec))
+    {
+      throw std::runtime_error("failed to create utext");
+    }
+
+    std::unique_ptr<UText, decltype(&utext_close)> text_close {&text, utext_close};
+
+    auto& iter = this->iter();
+    iter.setText(&text, ec);
+
+    if (U_FAILURE(ec))
+    {
+      throw std::runtime_error("failed to set break iterator text");
+    }
+
+    UChar32 uch;
+    int width {0};
+    size_type cols {0};
+    auto begin = iter.first();
+    auto end = iter.next();
+
+    while (end != iter_end)
+    {
+      // get column width
+      uch = utext_char32At(&text, begin);
+      width = u_getIntPropertyValue(uch, UCHAR_EAST_ASIAN_WIDTH);
+      if (width == U_EA_FULLWIDTH || width == U_EA_WIDE)
+      {
+        // full width
+        cols = 2;
+      }
+      else
+      {
+        // half width
+        cols = 1;
+      }
+
+      push(str, static_cast<size_type>(end - begin), cols);
+
+      // increase iterators
+      begin = end;
+      end = iter.next();
+    }
+  }
+
   // array of contexts mapping the string
   value_type _view;
 